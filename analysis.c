@@ -0,0 +1,295 @@
+/****** analysis.c **********************************************************
+*   Description
+*       Dataflow critical path and machine bounds of a trace for
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "analysis.h"
+#include "station.h"
+
+// instructions of the critical path listed in the report
+#define PATH_SHOWN      16
+
+// first cycle of the simulation
+#define FIRST_CYCLE     1
+
+static int _init_bound(struct bound* b, int num_regs, int num_stations);
+static long _time(struct dataflow* d, struct bound* b, struct instruction* inst,
+                  long issue);
+static long _issue_width(struct dataflow* d, struct bound* b);
+static long _issue_station(struct dataflow* d, struct bound* b,
+                           struct instruction* inst, long earliest, int* chosen);
+static void _take_slot(struct bound* b, long issue);
+static void _release(struct path_node* node);
+static void _hold(struct path_node** ref, struct path_node* node);
+
+
+struct dataflow* create_dataflow(struct state* s) {
+    struct dataflow* d = calloc(1, sizeof(struct dataflow));
+    if (d == NULL) {
+        return NULL;
+    }
+
+    d->regfile_size = s->regfile_size;
+    d->num_regs = NUM_REGS(s);
+    d->vector_cycles = s->vector_cycles;
+    d->issue_width = s->issue_width;
+    d->latency = s->latency;
+    d->num_stations = s->stations->occupied;
+    d->station_type = malloc(d->num_stations * sizeof(enum opclasses));
+    d->reg_node = calloc(d->num_regs, sizeof(struct path_node*));
+    if (!d->station_type || !d->reg_node) {
+        return NULL;
+    }
+    for (int i = 0; i < d->num_stations; i++) {
+        d->station_type[i] = s->stations->data[i].type;
+    }
+
+    if (_init_bound(&d->ideal, d->num_regs, 0) ||
+            _init_bound(&d->width, d->num_regs, 0) ||
+            _init_bound(&d->stations, d->num_regs, d->num_stations)) {
+        return NULL;
+    }
+    return d;
+}
+
+
+int dataflow_update(struct dataflow* d, struct ilist* program) {
+    for (; d->analyzed < program->dropped + program->occupied; d->analyzed++) {
+        struct instruction* inst = &program->data[d->analyzed - program->dropped];
+
+        // every model starts from the same dependencies, the chain is
+        // followed through the source written back last on the ideal one
+        struct path_node* pred = NULL;
+        if (has_sources(inst)) {
+            int r1 = reg_index(inst, inst->rs1, d->regfile_size);
+            int r2 = reg_index(inst, inst->rs2, d->regfile_size);
+            int src = (d->ideal.reg_ready[r2] > d->ideal.reg_ready[r1]) ? r2 : r1;
+            pred = d->reg_node[src];
+        }
+
+        long retired = _time(d, &d->ideal, inst, FIRST_CYCLE);
+        long issue = _issue_width(d, &d->width);
+        _take_slot(&d->width, issue);
+        _time(d, &d->width, inst, issue);
+
+        int chosen;
+        long in_order = _issue_width(d, &d->stations);
+        issue = _issue_station(d, &d->stations, inst, in_order, &chosen);
+        _take_slot(&d->stations, issue);
+        d->station_delay[inst->opclass] += issue - in_order;
+        long wb = _time(d, &d->stations, inst, issue) - 1;
+        if (chosen >= 0) {
+            d->stations.station_free[chosen] = wb + 1;
+        }
+
+        struct path_node* node = malloc(sizeof(struct path_node));
+        if (node == NULL) {
+            return -1;
+        }
+        node->index = d->analyzed;
+        node->text = inst->text;
+        node->op = inst->op;
+        node->length = pred ? pred->length + 1 : 1;
+        node->refs = 0;
+        node->pred = NULL;
+        _hold(&node->pred, pred);
+
+        // the chain ending here is critical if it retires last
+        if (!d->critical || retired > d->ideal.last_retire ||
+                (retired == d->ideal.last_retire && node->length > d->critical->length)) {
+            _hold(&d->critical, node);
+        }
+        if (retired > d->ideal.last_retire) {
+            d->ideal.last_retire = retired;
+        }
+        if (has_destination(inst)) {
+            _hold(&d->reg_node[reg_index(inst, inst->rd, d->regfile_size)], node);
+        }
+    }
+    return 0;
+}
+
+
+void dataflow_report(struct dataflow* d, struct thread* t) {
+    long simulated = t->last_retire;
+    long ideal = d->ideal.last_retire;
+    long width = d->width.last_retire;
+    long stations = d->stations.last_retire;
+    const char* verdict;
+
+    puts("");
+    if (!d->critical) {
+        puts("Critical path : empty program");
+        return;
+    }
+    printf("Critical path : %ld instructions, %ld cycles\n",
+        d->critical->length, ideal);
+
+    // the chain is linked from its end, keep the last instructions
+    struct path_node* shown[PATH_SHOWN];
+    int n = 0;
+    for (struct path_node* p = d->critical; p && n < PATH_SHOWN; p = p->pred) {
+        shown[n++] = p;
+    }
+    if (d->critical->length > n) {
+        printf("  ... %ld earlier instructions\n", d->critical->length - n);
+    }
+    while (n-- > 0) {
+        printf("  %8zu  %-24s %3d cycles\n", shown[n]->index + 1, shown[n]->text,
+            d->latency[shown[n]->op]);
+    }
+
+    puts("");
+    printf("%-36s %10s %8s\n", "Bound", "Cycles", "Gap");
+    printf("%-36s %10ld %8s\n", "dataflow (critical path)", ideal, "");
+    printf("%-36s %10ld %+8ld\n", "+ in-order issue width", width, width - ideal);
+    printf("%-36s %10ld %+8ld\n", "+ reservation stations", stations, stations - width);
+    for (int c = 0; c < num_opclasses; c++) {
+        if (d->station_delay[c]) {
+            printf("    %-32s %10s %8s (%ld issue cycles stalled)\n",
+                opclass_names[c], "", "", d->station_delay[c]);
+        }
+    }
+    printf("%-36s %10ld %+8ld\n", "simulated", simulated, simulated - stations);
+    printf("Simulated / dataflow bound : %.3f\n",
+        ideal ? (double) simulated / ideal : 0.0);
+
+    // the largest contribution names what limits the program
+    long gaps[] = {width - ideal, stations - width, simulated - stations};
+    const char* causes[] = {"issue width bound", "station bound",
+                            "bound by sharing with other threads"};
+    verdict = "latency bound";
+    long largest = simulated / 10;
+    for (int i = 0; i < 3; i++) {
+        if (gaps[i] > largest) {
+            largest = gaps[i];
+            verdict = causes[i];
+        }
+    }
+    printf("Verdict : %s\n", verdict);
+}
+
+
+static int _init_bound(struct bound* b, int num_regs, int num_stations) {
+    b->reg_ready = calloc(num_regs, sizeof(long));
+    if (num_stations) {
+        b->station_free = malloc(num_stations * sizeof(long));
+        if (b->station_free == NULL) {
+            return -1;
+        }
+        for (int i = 0; i < num_stations; i++) {
+            b->station_free[i] = FIRST_CYCLE;
+        }
+    }
+    b->issue = FIRST_CYCLE;
+    return (b->reg_ready == NULL) ? -1 : 0;
+}
+
+
+static long _time(struct dataflow* d, struct bound* b, struct instruction* inst,
+                  long issue) {
+    // time an instruction issued at the given cycle, return its retirement.
+    // execution starts the cycle after issue, and after the sources are
+    // written back; a register not yet written is ready (0). A vector
+    // register is ready, chained, once its first elements are produced
+    long start = issue + 1;
+    if (has_sources(inst)) {
+        long ready = b->reg_ready[reg_index(inst, inst->rs1, d->regfile_size)];
+        long ready2 = b->reg_ready[reg_index(inst, inst->rs2, d->regfile_size)];
+        if (ready2 > ready) {
+            ready = ready2;
+        }
+        if (ready + 1 > start) {
+            start = ready + 1;
+        }
+    }
+    long wb = start + d->latency[inst->op];
+    if (has_destination(inst)) {
+        b->reg_ready[reg_index(inst, inst->rd, d->regfile_size)] = wb;
+    }
+    if (inst->opclass == vector) {
+        wb += d->vector_cycles - 1;
+    }
+    if (wb + 1 > b->last_retire) {
+        b->last_retire = wb + 1;
+    }
+    return wb + 1;
+}
+
+
+static long _issue_width(struct dataflow* d, struct bound* b) {
+    // in order : not before the previous instruction, and issue_width per
+    // cycle. Returns the first cycle available, without taking the slot
+    if (b->issued >= d->issue_width) {
+        return b->issue + 1;
+    }
+    return b->issue;
+}
+
+
+static long _issue_station(struct dataflow* d, struct bound* b,
+                           struct instruction* inst, long earliest, int* chosen) {
+    // wait for the station of the right type that frees up first
+    long issue = -1;
+    *chosen = -1;
+    for (int i = 0; i < d->num_stations; i++) {
+        if (d->station_type[i] != inst->opclass) {
+            continue;
+        }
+        if (issue < 0 || b->station_free[i] < issue) {
+            issue = b->station_free[i];
+            *chosen = i;
+        }
+    }
+    if (issue < earliest) {
+        issue = earliest;
+    }
+    return issue;
+}
+
+
+static void _take_slot(struct bound* b, long issue) {
+    if (issue == b->issue) {
+        b->issued++;
+    } else {
+        b->issue = issue;
+        b->issued = 1;
+    }
+}
+
+
+static void _hold(struct path_node** ref, struct path_node* node) {
+    // make ref point to node, releasing what it pointed to before
+    if (node) {
+        node->refs++;
+    }
+    if (*ref) {
+        _release(*ref);
+    }
+    *ref = node;
+}
+
+
+static void _release(struct path_node* node) {
+    // free nodes no longer referenced, walking the chain backward
+    while (node && --node->refs <= 0) {
+        struct path_node* pred = node->pred;
+        free(node);
+        node = pred;
+    }
+}
@@ -0,0 +1,126 @@
+/****** analysis.h **********************************************************
+*   Description
+*       Dataflow critical path and machine bounds of a trace for
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdlib.h>
+#include "instruction.h"
+#include "tomasulo.h"
+
+// The trace is timed, in one pass, on three idealized machines, each
+// adding one constraint of the real one :
+//  ideal    : unlimited stations and issue width, only RAW dependencies
+//             and latencies count. Its length is the critical path.
+//  width    : instructions issue in order, issue_width per cycle
+//  stations : an instruction also waits for a free station of its type
+// Timing follows the engine : execution starts the cycle after issue and
+// after the sources are written back, takes latency cycles, and a station
+// can be reused the cycle after its writeback. The CDB broadcasts every
+// result in the cycle it is produced, so it adds no constraint.
+// Memory grows with the length of the trace : a dependency chain keeps one
+// node per instruction on it, and the node texts point into the program,
+// so the retired instructions are not compacted while analyzing.
+
+// instruction on a dependency chain, shared by the chains that go through
+// it and freed when no register or later instruction refers to it
+struct path_node {
+    size_t index;
+    const char* text;           // the program may have dropped it since
+    enum opcode op;
+    long length;                // instructions on the chain up to this one
+    int refs;
+    struct path_node* pred;     // source that was written back last
+};
+
+struct bound {
+    long* reg_ready;            // writeback cycle of the last writer
+    long* station_free;         // first cycle a station can be issued into
+    long issue;                 // issue cycle of the previous instruction
+    int issued;                 // instructions issued in that cycle
+    long last_retire;
+};
+
+struct dataflow {
+    int regfile_size;
+    int num_regs;                   // scalar then vector registers
+    int vector_cycles;
+    int issue_width;
+    const int* latency;
+    int num_stations;
+    enum opclasses* station_type;
+
+    struct bound ideal;
+    struct bound width;
+    struct bound stations;
+
+    struct path_node** reg_node;    // chain ending at each register
+    struct path_node* critical;     // chain ending at the last retirement
+    size_t analyzed;                // instructions of the program seen
+    long station_delay[num_opclasses];  // issue cycles lost waiting
+};
+
+
+/****** create_dataflow *****************************************************
+*   Prepare the analysis of a trace for the machine of a simulation
+*       
+*   Parameters : 
+*       struct state* s         : simulation context, after its stations
+*                                 are built
+*
+*   Return : pointer to the newly allocated analysis if successful
+*            NULL if memory allocation fails
+*
+*   Side effects : 
+*           memory for one entry per register and station is allocated
+*****************************************************************************/
+struct dataflow* create_dataflow(struct state* s);
+
+
+/****** dataflow_update *****************************************************
+*   Analyze the instructions added to a program since the previous call
+*       
+*   Parameters : 
+*       struct dataflow* d      : analysis of the program
+*       struct ilist* program   : program, as loaded so far
+*
+*   Return : 0 if succesfull, -1 if memory allocation fails
+*
+*   Side effects : 
+*           memory for the nodes of new dependency chains is allocated,
+*           nodes that left every chain are freed
+*****************************************************************************/
+int dataflow_update(struct dataflow* d, struct ilist* program);
+
+
+/****** dataflow_report *****************************************************
+*   Display the critical path, the bound of each machine model, and how
+*   the simulated cycles of a thread compare to them
+*       
+*   Parameters : 
+*       struct dataflow* d      : analysis of the program of the thread
+*       struct thread* t        : simulated thread
+*
+*   Return : none
+*
+*   Side effects : 
+*           the report is sent to the terminal
+*****************************************************************************/
+void dataflow_report(struct dataflow* d, struct thread* t);
+
+#endif
@@ -0,0 +1,40 @@
+/****** array.c *************************************************************
+*   Description
+*       Growth of dynamic arrays for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include "array.h"
+
+#define INITIAL_SIZE    256
+
+
+int grow_array(void* array, size_t* size, size_t needed, size_t elem) {
+    if (needed <= *size) {
+        return 0;
+    }
+
+    size_t new_size = *size ? *size : INITIAL_SIZE;
+    while (new_size < needed) {
+        new_size <<= 1;
+    }
+    void** p = array;
+    void* new_array = realloc(*p, new_size * elem);
+    if (new_array == NULL) {
+        return -1;
+    }
+    *p = new_array;
+    *size = new_size;
+    return 0;
+}
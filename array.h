@@ -0,0 +1,43 @@
+/****** array.h *************************************************************
+*   Description
+*       Growth of dynamic arrays for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef ARRAY_H
+#define ARRAY_H
+
+#include <stdlib.h>
+
+
+/****** grow_array **********************************************************
+*   Make room for at least needed elements in an array, doubling its
+*   capacity as many times as necessary
+*       
+*   Parameters : 
+*       void* array             : address of the pointer to the array,
+*                                 which may be NULL if size is 0
+*       size_t* size            : capacity of the array, in elements
+*       size_t needed           : elements the array must hold
+*       size_t elem             : size of an element
+*
+*   Return : 0 if succesfull, non-zero if memory allocation fails
+*
+*   Side effects : 
+*           the array may be moved and size updated. If memory allocation
+*           fails, both are unchanged and the array is still valid
+*****************************************************************************/
+int grow_array(void* array, size_t* size, size_t needed, size_t elem);
+
+#endif
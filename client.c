@@ -0,0 +1,224 @@
+/****** client.c ************************************************************
+*   Description
+*       Command line client of the simulation server of Tomasulo's
+*       algorithm simulator : submits jobs and displays their results
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+#define LINE_LENGTH     512
+
+// results are read on their own thread while jobs are still sent : the
+// server must never wait for the client to stop sending to deliver them
+struct reader {
+    int fd;
+    bool failed;            // a job was answered with an error
+};
+
+int send_directive(FILE* out, const char* word, const char* value);
+int send_jobs(FILE* out, const char* filename);
+void* read_results(void* arg);
+void usage(const char* prog);
+
+
+int main(int argc, char* argv[]) {
+    static struct option long_options[] = {
+        {"socket",  required_argument, NULL, 's'},
+        {"jobs",    required_argument, NULL, 'f'},
+        {"machine", required_argument, NULL, 'm'},
+        {"width",   required_argument, NULL, 'w'},
+        {"policy",  required_argument, NULL, 'p'},
+        {"help",    no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    const char* path = SERVER_SOCKET;
+    const char* jobs_file = NULL;
+    const char* machine_file = NULL;
+    const char* width = NULL;
+    const char* policy = NULL;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "s:f:m:w:p:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 's':
+                path = optarg;
+                break;
+            case 'f':
+                jobs_file = optarg;
+                break;
+            case 'm':
+                machine_file = optarg;
+                break;
+            case 'w':
+                width = optarg;
+                break;
+            case 'p':
+                policy = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+    if (!jobs_file && optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("socket path too long : %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr))) {
+        printf("cannot connect to %s, is the server running ?\n", path);
+        return 1;
+    }
+
+    // results are displayed as they arrive, while jobs are being sent
+    struct reader r = {.fd = fd};
+    pthread_t thread;
+    FILE* out = fdopen(dup(fd), "w");
+    if (!out || pthread_create(&thread, NULL, read_results, &r)) {
+        puts("connection failed");
+        return 1;
+    }
+    if (jobs_file && send_jobs(out, jobs_file)) {
+        printf("could not read %s\n", jobs_file);
+        return 1;
+    }
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            if (send_directive(out, "trace", argv[i])) {
+                printf("could not find %s\n", argv[i]);
+                return 1;
+            }
+        }
+        if (machine_file && send_directive(out, "machine", machine_file)) {
+            printf("could not find %s\n", machine_file);
+            return 1;
+        }
+        if (width) {
+            send_directive(out, "width", width);
+        }
+        if (policy) {
+            send_directive(out, "policy", policy);
+        }
+        fputs("run\n", out);
+    }
+    // the server closes the connection once every job is answered
+    fclose(out);
+    shutdown(fd, SHUT_WR);
+    pthread_join(thread, NULL);
+    return r.failed ? 1 : 0;
+}
+
+
+void* read_results(void* arg) {
+    struct reader* r = arg;
+    FILE* in = fdopen(r->fd, "r");
+    char line[LINE_LENGTH];
+
+    while (in && fgets(line, sizeof(line), in)) {
+        if (!strncmp(line, "error", 5)) {
+            r->failed = true;
+        }
+        fputs(line, stdout);
+        fflush(stdout);
+    }
+    if (in) {
+        fclose(in);
+    }
+    return NULL;
+}
+
+
+int send_directive(FILE* out, const char* word, const char* value) {
+    // the server has its own working directory, files are sent as
+    // absolute paths. A missing file is still sent, the job reports it
+    char absolute[PATH_MAX];
+    int result = 0;
+
+    if (!strcmp(word, "trace") || !strcmp(word, "machine")) {
+        if (realpath(value, absolute)) {
+            value = absolute;
+        } else {
+            result = -1;
+        }
+    }
+    fprintf(out, "%s %s\n", word, value);
+    return result;
+}
+
+
+int send_jobs(FILE* out, const char* filename) {
+    // a jobs file holds directives as understood by the server, one per
+    // line (see server.h), with paths relative to the jobs file
+    FILE* jobs = fopen(filename, "rt");
+    char line[LINE_LENGTH];
+    char path[PATH_MAX + LINE_LENGTH];
+
+    if (!jobs) {
+        return -1;
+    }
+    const char* slash = strrchr(filename, '/');
+    int dir_length = slash ? slash - filename + 1 : 0;
+
+    while (fgets(line, sizeof(line), jobs)) {
+        char word[16];
+        char value[LINE_LENGTH];
+        int n = sscanf(line, " %15s %511[^\r\n]", word, value);
+
+        if (n == 1) {
+            // a job starts as soon as it is complete
+            fprintf(out, "%s\n", word);
+            fflush(out);
+        } else if (n == 2 && (!strcmp(word, "trace") || !strcmp(word, "machine"))) {
+            snprintf(path, sizeof(path), "%.*s%s", (value[0] == '/') ? 0 : dir_length,
+                     filename, value);
+            send_directive(out, word, path);
+        } else if (n == 2) {
+            send_directive(out, word, value);
+        }
+    }
+    fclose(jobs);
+    return 0;
+}
+
+
+void usage(const char* prog) {
+    printf("usage : %s [options] [trace ...]\n", prog);
+    puts("  submits the traces as one job to a simulation server (tomasulo --serve)");
+    puts("  and displays the results as they arrive");
+    puts("  -s, --socket PATH    server socket (default " SERVER_SOCKET ")");
+    puts("  -f, --jobs FILE      also submit the jobs described in FILE");
+    puts("  -m, --machine FILE   machine description of the job");
+    puts("  -w, --width N        instructions issued per cycle");
+    puts("  -p, --policy POLICY  SMT issue policy : rr or icount");
+    puts("  -h, --help           display this message");
+}
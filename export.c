@@ -0,0 +1,210 @@
+/****** export.c ************************************************************
+*   Description
+*       Streaming export of the timeline of every instruction, as CSV or
+*       JSON Lines, for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include "export.h"
+#include "instruction.h"
+#include "station.h"
+
+// room left in the buffer before composing a record : a decoded text is
+// less than 512 characters (renamed repeat bodies), 6 each once escaped
+// at worst
+#define RECORD_MAX      4096
+
+#define NUM_FIELDS      13
+
+// ordered as the values composed by _record
+static const char* field_names[] = {"thread", "inst", "text", "op", "opclass",
+                                    "station", "issue", "execute",
+                                    "writeback", "retired", "latency",
+                                    "issue_stall", "operand_stall"};
+
+static void _record(struct exporter* e, struct state* s, int n,
+                    struct instruction* inst);
+static void _append(struct exporter* e, const char* text);
+static void _number(struct exporter* e, long value);
+static void _quote(struct exporter* e, const char* text);
+static int _flush(struct exporter* e);
+
+
+struct exporter* create_exporter(const char* filename, int num_threads) {
+    struct exporter* e = calloc(1, sizeof(struct exporter));
+    if (!e) {
+        return NULL;
+    }
+    size_t length = strlen(filename);
+    bool json = (length > 6 && !strcmp(filename + length - 6, ".jsonl")) ||
+                (length > 5 && !strcmp(filename + length - 5, ".json"));
+    e->format = json ? export_jsonl : export_csv;
+    e->num_threads = num_threads;
+    e->buffer = malloc(EXPORT_BUFFER);
+    e->exported = calloc(num_threads, sizeof(size_t));
+    e->last_issue = calloc(num_threads, sizeof(long));
+    if (!e->buffer || !e->exported || !e->last_issue) {
+        return NULL;
+    }
+
+    e->out = fopen(filename, "w");
+    if (!e->out) {
+        return NULL;
+    }
+    // blocks are already as large as worth writing, stdio would copy them
+    setvbuf(e->out, NULL, _IONBF, 0);
+
+    if (e->format == export_csv) {
+        for (int f = 0; f < NUM_FIELDS; f++) {
+            _append(e, f ? "," : "");
+            _append(e, field_names[f]);
+        }
+        _append(e, "\n");
+    }
+    return e;
+}
+
+
+int export_retired(struct exporter* e, struct state* s) {
+    if (e->failed) {
+        return -1;
+    }
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        struct ilist* program = t->program;
+
+        // exported counts from the start of the trace, head from the
+        // instructions still in the list
+        for (; e->exported[n] < t->head + program->dropped; e->exported[n]++) {
+            if (e->length + RECORD_MAX > EXPORT_BUFFER && _flush(e)) {
+                return -1;
+            }
+            _record(e, s, n, &program->data[e->exported[n] - program->dropped]);
+        }
+    }
+    return 0;
+}
+
+
+int close_exporter(struct exporter* e) {
+    int result = (e->failed || _flush(e)) ? -1 : 0;
+    if (fclose(e->out)) {
+        result = -1;
+    }
+    free(e->buffer);
+    free(e->exported);
+    free(e->last_issue);
+    free(e);
+    return result;
+}
+
+
+static void _record(struct exporter* e, struct state* s, int n,
+                    struct instruction* inst) {
+    // the previous record of the thread is the previous instruction, an
+    // instruction issued in the same cycle did not stall
+    long issue_stall = inst->issue - e->last_issue[n] - 1;
+    e->last_issue[n] = inst->issue;
+
+    const char* strings[] = {NULL, NULL, inst->text, inst->name,
+                             opclass_names[inst->opclass],
+                             s->stations->data[inst->station].name};
+    long numbers[] = {n, e->exported[n] + 1, 0, 0, 0, 0,
+                      inst->issue, inst->execute, inst->writeback,
+                      inst->retired, inst->latency,
+                      (issue_stall > 0) ? issue_stall : 0,
+                      inst->execute - inst->issue - 1};
+
+    // composed by hand, snprintf would take most of the time of a record
+    for (int f = 0; f < NUM_FIELDS; f++) {
+        if (e->format == export_jsonl) {
+            _append(e, f ? ",\"" : "{\"");
+            _append(e, field_names[f]);
+            _append(e, "\":");
+        } else if (f) {
+            _append(e, ",");
+        }
+        if (f < 2 || f > 5) {
+            _number(e, numbers[f]);
+        } else if (f == 2 || e->format == export_jsonl) {
+            // names of opcodes, classes and stations need no escaping
+            _quote(e, strings[f]);
+        } else {
+            _append(e, strings[f]);
+        }
+    }
+    _append(e, (e->format == export_jsonl) ? "}\n" : "\n");
+}
+
+
+static void _append(struct exporter* e, const char* text) {
+    size_t length = strlen(text);
+    memcpy(e->buffer + e->length, text, length);
+    e->length += length;
+}
+
+
+static void _number(struct exporter* e, long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long v = (value < 0) ? -(unsigned long) value : (unsigned long) value;
+
+    do {
+        digits[count++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    if (value < 0) {
+        e->buffer[e->length++] = '-';
+    }
+    while (count) {
+        e->buffer[e->length++] = digits[--count];
+    }
+}
+
+
+static void _quote(struct exporter* e, const char* text) {
+    // CSV doubles its quotes, JSON escapes them as well as backslashes and
+    // control characters
+    char* p = e->buffer + e->length;
+
+    *p++ = '"';
+    for (; *text; text++) {
+        unsigned char c = *text;
+        if (c == '"') {
+            *p++ = (e->format == export_csv) ? '"' : '\\';
+            *p++ = '"';
+        } else if (e->format == export_jsonl && c == '\\') {
+            *p++ = '\\';
+            *p++ = '\\';
+        } else if (e->format == export_jsonl && c < 0x20) {
+            p += sprintf(p, "\\u%04x", c);
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    e->length = p - e->buffer;
+}
+
+
+static int _flush(struct exporter* e) {
+    if (e->length && fwrite(e->buffer, 1, e->length, e->out) != e->length) {
+        e->failed = true;
+        return -1;
+    }
+    e->length = 0;
+    return 0;
+}
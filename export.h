@@ -0,0 +1,103 @@
+/****** export.h ************************************************************
+*   Description
+*       Streaming export of the timeline of every instruction, as CSV or
+*       JSON Lines, for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "tomasulo.h"
+
+#define EXPORT_BUFFER   (1 << 20)
+
+// One record per instruction, written once it and every older instruction
+// of its thread have retired : records of a thread are in program order,
+// and they are written before compaction drops the instructions. Fields :
+//  thread, inst        hardware thread and number in its trace, from 1
+//  text, op, opclass   as decoded
+//  station             station it issued to
+//  issue, execute, writeback, retired   cycles, as in the display
+//  latency             execution cycles of the machine, or drawn
+//  issue_stall         cycles without issuing in its thread before it
+//                      (structural hazards, issue width, other threads)
+//  operand_stall       cycles between issue and the start of execution
+// Records are composed in a buffer, sent to the file in blocks of
+// EXPORT_BUFFER bytes.
+
+enum export_format {export_csv, export_jsonl};
+
+struct exporter {
+    FILE* out;
+    enum export_format format;
+    char* buffer;
+    size_t length;
+    int num_threads;
+    size_t* exported;       // per thread, records written so far
+    long* last_issue;       // per thread, issue cycle of the last record
+    bool failed;            // a write failed, nothing more is written
+};
+
+
+/****** create_exporter *****************************************************
+*   Open the export file and write the header of the format
+*
+*   Parameters :
+*       const char* filename        : file to create, a name ending with
+*                                     .jsonl or .json selects JSON Lines,
+*                                     any other CSV
+*       int num_threads             : hardware threads of the simulation
+*
+*   Return : pointer to the newly allocated exporter if successful
+*            NULL if the file cannot be created or memory allocation fails
+*
+*   Side effects :
+*           the file is created, memory for the buffer is allocated
+*****************************************************************************/
+struct exporter* create_exporter(const char* filename, int num_threads);
+
+
+/****** export_retired ******************************************************
+*   Add the records of the instructions retired since the last call, up to
+*   the oldest one not yet retired of each thread
+*
+*   Parameters :
+*       struct exporter* e          : exporter
+*       struct state* s             : current simulation context
+*
+*   Return : 0 if successful, -1 if the file could not be written
+*
+*   Side effects :
+*           full blocks of the buffer are written to the file
+*****************************************************************************/
+int export_retired(struct exporter* e, struct state* s);
+
+
+/****** close_exporter ******************************************************
+*   Write the rest of the buffer, close the file and free the exporter
+*
+*   Parameters :
+*       struct exporter* e          : exporter
+*
+*   Return : 0 if every record was written, -1 otherwise
+*
+*   Side effects :
+*           the file is closed, memory is freed
+*****************************************************************************/
+int close_exporter(struct exporter* e);
+
+#endif
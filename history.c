@@ -0,0 +1,400 @@
+/****** history.c ***********************************************************
+*   Description
+*       Recorded simulation history, for stepping backward and jumping to
+*       any past cycle in the interactive mode of Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "history.h"
+#include "instruction.h"
+#include "station.h"
+#include "registers.h"
+#include "array.h"
+
+// slot layout :
+//  complete, rr_next
+//  per thread : head, next, in_flight, retired, last_retire, register Qs
+//  per station : busy, thread, op, vj, vk, qj, qk
+#define GLOBAL_SLOTS    2
+#define THREAD_SLOTS    5
+#define STATION_SLOTS   7
+
+// instruction fields kept in struct stamps
+#define FIELDS          5
+#define REMAINING       4
+
+static long _get(struct history* h, struct state* s, size_t slot);
+static void _set(struct history* h, struct state* s, size_t slot, long value);
+static void _encode(struct history* h, struct state* s, long* slots);
+static int _record_insts(struct history* h, struct state* s);
+static int _record_slots(struct history* h, struct state* s);
+static int _log(struct history* h, int thread, size_t index, long value);
+static int _keyframe(struct history* h, struct state* s);
+static void _mask(struct history* h, struct state* s, int n, size_t first,
+                  size_t last, long cycle);
+
+
+struct history* create_history(struct state* s, char* reg_names[]) {
+    struct history* h = calloc(1, sizeof(struct history));
+    if (h == NULL) {
+        return NULL;
+    }
+
+    h->reg_names = reg_names;
+    h->num_slots = GLOBAL_SLOTS
+                 + s->num_threads * (THREAD_SLOTS + NUM_REGS(s))
+                 + s->stations->occupied * STATION_SLOTS;
+    h->shadow = malloc(h->num_slots * sizeof(long));
+    h->scratch = malloc(h->num_slots * sizeof(long));
+    h->stamps = calloc(s->num_threads, sizeof(struct stamps));
+    h->busy = calloc(s->stations->occupied, sizeof(struct events));
+    if (!h->shadow || !h->scratch || !h->stamps || !h->busy) {
+        return NULL;
+    }
+
+    // cycle 0 is the initial state, the first keyframe
+    _encode(h, s, h->shadow);
+    if (grow_array(&h->cycle_start, &h->cycles_size, 2, sizeof(size_t)) ||
+            _keyframe(h, s)) {
+        return NULL;
+    }
+    h->cycle_start[0] = 0;
+    return h;
+}
+
+
+int history_record(struct history* h, struct state* s) {
+    long cycle = s->cycle;
+
+    if (grow_array(&h->cycle_start, &h->cycles_size, cycle + 2, sizeof(size_t))) {
+        return -1;
+    }
+    h->cycle_start[cycle] = h->log_length;
+    h->frontier = cycle;
+
+    // instructions first, the previous heads are still in the shadow slots
+    if (_record_insts(h, s) || _record_slots(h, s)) {
+        return -1;
+    }
+    h->cycle_start[cycle + 1] = h->log_length;
+
+    size_t keyframe_size = h->num_slots;
+    for (int n = 0; n < s->num_threads; n++) {
+        keyframe_size += s->threads[n].next - s->threads[n].head;
+    }
+    if (h->since_keyframe >= keyframe_size) {
+        return _keyframe(h, s);
+    }
+    return 0;
+}
+
+
+void history_seek(struct history* h, struct state* s, long cycle) {
+    // last keyframe at or before the cycle
+    size_t lo = 0;
+    size_t hi = h->num_keyframes;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (h->keyframes[mid].cycle <= cycle) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    struct keyframe* k = &h->keyframes[lo];
+
+    size_t* old_head = malloc(2 * s->num_threads * sizeof(size_t));
+    if (old_head == NULL) {
+        return;
+    }
+    size_t* old_next = old_head + s->num_threads;
+    for (int n = 0; n < s->num_threads; n++) {
+        old_head[n] = s->threads[n].head;
+        old_next[n] = s->threads[n].next;
+    }
+
+    // slots : keyframe, then the changes of the following cycles
+    for (size_t i = 0; i < h->num_slots; i++) {
+        _set(h, s, i, k->data[i]);
+    }
+    size_t first = h->cycle_start[k->cycle + 1];
+    size_t last = h->cycle_start[cycle + 1];
+    for (size_t i = first; i < last; i++) {
+        if (h->log[i].thread < 0) {
+            _set(h, s, h->log[i].index, h->log[i].value);
+        }
+    }
+
+    // instructions : every one that is in flight now or was at the keyframe
+    // or at the target cycle is rebuilt, the others did not change
+    long* remaining = k->data + h->num_slots;
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        size_t kf_head = k->data[GLOBAL_SLOTS + n * (THREAD_SLOTS + NUM_REGS(s))];
+        size_t kf_next = k->data[GLOBAL_SLOTS + n * (THREAD_SLOTS + NUM_REGS(s)) + 1];
+        size_t from = (old_head[n] < kf_head) ? old_head[n] : kf_head;
+        size_t to = (old_next[n] > t->next) ? old_next[n] : t->next;
+
+        _mask(h, s, n, from, to, cycle);
+        for (size_t i = kf_head; i < kf_next; i++) {
+            t->program->data[i].remaining = *remaining++;
+        }
+    }
+    for (size_t i = first; i < last; i++) {
+        struct change* c = &h->log[i];
+        if (c->thread >= 0) {
+            s->threads[c->thread].program->data[c->index].remaining = c->value;
+        }
+    }
+
+    s->cycle = cycle;
+    free(old_head);
+}
+
+
+long history_find_busy(struct history* h, size_t station, long after) {
+    struct events* e = &h->busy[station];
+
+    // first event after the cycle
+    size_t lo = 0;
+    size_t hi = e->length;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (e->cycles[mid] <= after) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < e->length) ? e->cycles[lo] : 0;
+}
+
+
+long history_retired(struct history* h, int thread, size_t index) {
+    struct stamps* st = &h->stamps[thread];
+    if (index >= st->length) {
+        return 0;
+    }
+    return st->fields[index * FIELDS + 3];
+}
+
+
+static int _record_insts(struct history* h, struct state* s) {
+    // instructions that may have changed : from the oldest in flight at
+    // the previous cycle to the last issued
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        struct stamps* st = &h->stamps[n];
+        size_t head = h->shadow[GLOBAL_SLOTS + n * (THREAD_SLOTS + NUM_REGS(s))];
+
+        if (t->next > st->length) {
+            if (grow_array(&st->fields, &st->size, t->next * FIELDS, sizeof(long))) {
+                return -1;
+            }
+            memset(st->fields + st->length * FIELDS, 0,
+                   (t->next - st->length) * FIELDS * sizeof(long));
+            st->length = t->next;
+        }
+
+        for (size_t i = head; i < t->next; i++) {
+            struct instruction* inst = &t->program->data[i];
+            long* f = &st->fields[i * FIELDS];
+            f[0] = inst->issue;
+            f[1] = inst->execute;
+            f[2] = inst->writeback;
+            f[3] = inst->retired;
+            if (f[REMAINING] != inst->remaining) {
+                f[REMAINING] = inst->remaining;
+                if (_log(h, n, i, inst->remaining)) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+
+static int _record_slots(struct history* h, struct state* s) {
+    size_t stations = GLOBAL_SLOTS
+                    + s->num_threads * (THREAD_SLOTS + NUM_REGS(s));
+
+    _encode(h, s, h->scratch);
+    for (size_t i = 0; i < h->num_slots; i++) {
+        if (h->scratch[i] == h->shadow[i]) {
+            continue;
+        }
+        if (_log(h, -1, i, h->scratch[i])) {
+            return -1;
+        }
+
+        // index the stations that became busy, for searches
+        if (i >= stations && (i - stations) % STATION_SLOTS == 0 && h->scratch[i]) {
+            struct events* e = &h->busy[(i - stations) / STATION_SLOTS];
+            if (grow_array(&e->cycles, &e->size, e->length + 1, sizeof(long))) {
+                return -1;
+            }
+            e->cycles[e->length++] = s->cycle;
+        }
+    }
+
+    long* tmp = h->shadow;
+    h->shadow = h->scratch;
+    h->scratch = tmp;
+    return 0;
+}
+
+
+static int _log(struct history* h, int thread, size_t index, long value) {
+    if (grow_array(&h->log, &h->log_size, h->log_length + 1, sizeof(struct change))) {
+        return -1;
+    }
+    h->log[h->log_length++] = (struct change){thread, value, index};
+    h->since_keyframe++;
+    return 0;
+}
+
+
+static int _keyframe(struct history* h, struct state* s) {
+    size_t length = h->num_slots;
+    for (int n = 0; n < s->num_threads; n++) {
+        length += s->threads[n].next - s->threads[n].head;
+    }
+
+    if (grow_array(&h->keyframes, &h->keyframes_size, h->num_keyframes + 1,
+                 sizeof(struct keyframe))) {
+        return -1;
+    }
+    long* data = malloc(length * sizeof(long));
+    if (data == NULL) {
+        return -1;
+    }
+
+    memcpy(data, h->shadow, h->num_slots * sizeof(long));
+    long* p = data + h->num_slots;
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        for (size_t i = t->head; i < t->next; i++) {
+            *p++ = t->program->data[i].remaining;
+        }
+    }
+
+    h->keyframes[h->num_keyframes++] = (struct keyframe){s->cycle, data};
+    h->since_keyframe = 0;
+    return 0;
+}
+
+
+static void _mask(struct history* h, struct state* s, int n, size_t first,
+                  size_t last, long cycle) {
+    // timestamps at a past cycle : the latest ones, if they were set by then
+    struct thread* t = &s->threads[n];
+    struct stamps* st = &h->stamps[n];
+
+    for (size_t i = first; i < last && i < st->length; i++) {
+        struct instruction* inst = &t->program->data[i];
+        long* f = &st->fields[i * FIELDS];
+        inst->issue = (f[0] <= cycle) ? f[0] : 0;
+        inst->execute = (f[1] <= cycle) ? f[1] : 0;
+        inst->writeback = (f[2] <= cycle) ? f[2] : 0;
+        inst->retired = (f[3] <= cycle) ? f[3] : 0;
+        inst->remaining = 0;
+    }
+}
+
+
+static void _encode(struct history* h, struct state* s, long* slots) {
+    for (size_t i = 0; i < h->num_slots; i++) {
+        slots[i] = _get(h, s, i);
+    }
+}
+
+
+static long _get(struct history* h, struct state* s, size_t slot) {
+    size_t per_thread = THREAD_SLOTS + NUM_REGS(s);
+
+    if (slot < GLOBAL_SLOTS) {
+        return (slot == 0) ? s->complete : s->rr_next;
+    }
+    slot -= GLOBAL_SLOTS;
+    if (slot < s->num_threads * per_thread) {
+        struct thread* t = &s->threads[slot / per_thread];
+        switch (slot % per_thread) {
+            case 0: return t->head;
+            case 1: return t->next;
+            case 2: return t->in_flight;
+            case 3: return t->retired;
+            case 4: return t->last_retire;
+        }
+        return t->reg_contents[slot % per_thread - THREAD_SLOTS];
+    }
+    slot -= s->num_threads * per_thread;
+
+    struct station* st = &s->stations->data[slot / STATION_SLOTS];
+    switch (slot % STATION_SLOTS) {
+        case 0: return st->busy;
+        case 1: return st->thread;
+        case 2: return st->busy ? (st->op - s->threads[st->thread].program->data) : -1;
+        case 3: return encode_operand(s, h->reg_names, st->vj);
+        case 4: return encode_operand(s, h->reg_names, st->vk);
+        case 5: return st->qj;
+    }
+    return st->qk;
+}
+
+
+static void _set(struct history* h, struct state* s, size_t slot, long value) {
+    size_t per_thread = THREAD_SLOTS + NUM_REGS(s);
+
+    if (slot < GLOBAL_SLOTS) {
+        if (slot == 0) {
+            s->complete = value;
+        } else {
+            s->rr_next = value;
+        }
+        return;
+    }
+    slot -= GLOBAL_SLOTS;
+    if (slot < s->num_threads * per_thread) {
+        struct thread* t = &s->threads[slot / per_thread];
+        switch (slot % per_thread) {
+            case 0: t->head = value; return;
+            case 1: t->next = value; return;
+            case 2: t->in_flight = value; return;
+            case 3: t->retired = value; return;
+            case 4: t->last_retire = value; return;
+        }
+        t->reg_contents[slot % per_thread - THREAD_SLOTS] = value;
+        return;
+    }
+    slot -= s->num_threads * per_thread;
+
+    struct station* st = &s->stations->data[slot / STATION_SLOTS];
+    switch (slot % STATION_SLOTS) {
+        case 0: st->busy = value; return;
+        case 1: st->thread = value; return;
+        case 2:
+            if (value >= 0) {
+                st->op = &s->threads[st->thread].program->data[value];
+            }
+            return;
+        case 3: st->vj = decode_operand(s, h->reg_names, value, NULL); return;
+        case 4: st->vk = decode_operand(s, h->reg_names, value, NULL); return;
+        case 5: st->qj = value; return;
+    }
+    st->qk = value;
+}
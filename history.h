@@ -0,0 +1,167 @@
+/****** history.h ***********************************************************
+*   Description
+*       Recorded simulation history, for stepping backward and jumping to
+*       any past cycle in the interactive mode of Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "tomasulo.h"
+
+// The machine state (threads, register Qs, stations) is numbered as a
+// vector of long slots. After every simulated cycle, the slots that changed
+// are appended to a log, along with the remaining cycles of instructions.
+// The other instruction fields are timestamps, set once : their latest
+// value tells whether they were already set at any past cycle, so only
+// the latest one is kept.
+//
+// A keyframe, a copy of the slots and of the in-flight remaining cycles,
+// is taken whenever the changes logged since the previous one outweigh
+// it. Any cycle is then rebuilt from the keyframe before it and at most a
+// keyframe's worth of changes, and memory grows with the number of
+// changes rather than with cycles.
+
+struct change {
+    int thread;                 // -1 : a machine slot, else an instruction
+    long value;
+    size_t index;               // slot or instruction index
+};
+
+struct keyframe {
+    long cycle;
+    long* data;                 // slots, then remaining cycles of each
+                                // thread's in-flight instructions
+};
+
+// latest value of the fields of the instructions of a thread
+struct stamps {
+    long* fields;               // issue, execute, writeback, retired, remaining
+    size_t length;              // instructions
+    size_t size;
+};
+
+// cycles where a station went from free to busy
+struct events {
+    long* cycles;
+    size_t length;
+    size_t size;
+};
+
+struct history {
+    char** reg_names;
+    size_t num_slots;
+    long* shadow;               // slots at the most recent cycle
+    long* scratch;
+    struct stamps* stamps;      // per thread
+    struct events* busy;        // per station
+
+    struct change* log;
+    size_t log_length;
+    size_t log_size;
+    size_t* cycle_start;        // first change of each cycle
+    size_t cycles_size;
+    long frontier;              // most recent cycle simulated
+
+    struct keyframe* keyframes;
+    size_t num_keyframes;
+    size_t keyframes_size;
+    size_t since_keyframe;      // changes logged since the last keyframe
+};
+
+
+/****** create_history ******************************************************
+*   Start recording a simulation, from its initial state
+*       
+*   Parameters : 
+*       struct state* s         : simulation context, before the first cycle
+*       char *reg_names[]       : names of the register Qs, as given to issue
+*
+*   Return : pointer to the newly allocated history if successful
+*            NULL if memory allocation fails
+*
+*   Side effects : 
+*           memory for the history and its first keyframe is allocated
+*****************************************************************************/
+struct history* create_history(struct state* s, char* reg_names[]);
+
+
+/****** history_record ******************************************************
+*   Record the changes made by the cycle just simulated. Must be called
+*   after every cycle, and only while the state is the most recent one.
+*       
+*   Parameters : 
+*       struct history* h       : history of the simulation
+*       struct state* s         : simulation context
+*
+*   Return : 0 if succesfull, -1 if memory allocation fails
+*
+*   Side effects : 
+*           memory for changes and keyframes is allocated
+*****************************************************************************/
+int history_record(struct history* h, struct state* s);
+
+
+/****** history_seek ********************************************************
+*   Bring the simulation back, or forward, to the end of a recorded cycle
+*       
+*   Parameters : 
+*       struct history* h       : history of the simulation
+*       struct state* s         : simulation context
+*       long cycle              : 1 to h->frontier
+*
+*   Return : none
+*
+*   Side effects : 
+*           threads, instructions, stations and register Qs are modified.
+*           The simulation may only continue from h->frontier.
+*****************************************************************************/
+void history_seek(struct history* h, struct state* s, long cycle);
+
+
+/****** history_find_busy ***************************************************
+*   Search the first recorded cycle after a given one where a station
+*   became busy
+*       
+*   Parameters : 
+*       struct history* h       : history of the simulation
+*       size_t station          : index of the station
+*       long after              : cycle where the search starts, excluded
+*
+*   Return : the cycle found, 0 if none was recorded
+*
+*   Side effects : none
+*****************************************************************************/
+long history_find_busy(struct history* h, size_t station, long after);
+
+
+/****** history_retired *****************************************************
+*   Find when an instruction retires, if it did by the most recent cycle
+*       
+*   Parameters : 
+*       struct history* h       : history of the simulation
+*       int thread              : thread of the instruction
+*       size_t index            : index of the instruction in its program
+*
+*   Return : the retirement cycle, 0 if it has not retired yet
+*
+*   Side effects : none
+*****************************************************************************/
+long history_retired(struct history* h, int thread, size_t index);
+
+#endif
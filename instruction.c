@@ -24,26 +24,39 @@
 #include <stdio.h>
 #include "instruction.h"
 
+#define TEXT_WIDTH      20
+
 static void _grow(struct ilist* list);
-static int _decode(struct ilist* list, int pos, char* text);
-static int _process_loadstore(struct instruction* inst, char* elem, char* text);
-static int _assign_register(int* regid, char* elem);
+static int _decode(struct instruction* inst, char* elem, char* text, char** save);
+static int _process_loadstore(struct instruction* inst, char** save, char* text,
+                              char prefix);
+static int _assign_register(int* regid, char** save, char prefix);
 static int _copy_inst_string(struct instruction* inst, char* text);
-static int _process_arithmetic(struct instruction* inst, char* elem, char* text);
+static int _process_arithmetic(struct instruction* inst, char** save, char* text,
+                               char prefix);
 
 // array of strings for instruction mnemonics
 // must be ordered the same as enum opcode for
 // opcode field assignment to work correctly
-const char* mnemonics[] = {"ld", "sw", "addd", "subd", "muld", "divd"};
+const char* mnemonics[] = {"ld", "sw", "addd", "subd", "muld", "divd",
+                           "lv", "sv", "addv", "subv", "mulv", "divv"};
 
 // array of ints for execution time
 // also ordered the same as enum opcode
-const int exec_cycles[] = { 1,    1,    2    ,  2    ,  4     ,  8};
+// these are the defaults, the machine description can replace them.
+// a vector instruction takes these cycles for its first elements, then
+// one more cycle per group of lanes (see machine.h)
+const int exec_cycles[] = { 1,    1,    2    ,  2    ,  4     ,  8,
+                            1,    1,    2    ,  2    ,  4     ,  8};
+
+// array of strings for execution unit types
+// ordered the same as enum opclasses
+const char* opclass_names[] = {"addsub", "muldiv", "loadstore", "vector"};
 
 
 void inst_details(struct instruction* inst) {
     printf("Text   : %s    name  : %s\n", inst->text, inst->name);
-    printf("issue  : %d  execute : %d  writeback : %d  retired : %d  remaining : %d\n",
+    printf("issue  : %ld  execute : %ld  writeback : %ld  retired : %ld  remaining : %d\n",
         inst->issue, inst->execute, inst->writeback, inst->retired, inst->remaining);
     printf("opcode : %d  opclass : %d\n", inst->op, inst->opclass);
     printf("    rd : %d,     rs1 : %d,       rs2 : %d\n\n", inst->rd, 
@@ -52,8 +65,20 @@ void inst_details(struct instruction* inst) {
 
 
 void print_inst(struct instruction* inst) {
-    printf("|%20s |%10d |%10d |%10d |%10d |\n",
-        inst->text, inst->issue, inst->execute, inst->writeback, inst->retired);
+    char line[80];
+    format_inst(line, sizeof(line), inst);
+    puts(line);
+}
+
+
+int format_inst(char* buf, size_t size, struct instruction* inst) {
+    // a text wider than its column is cut and ends with '~', the other
+    // columns stay aligned
+    bool cut = strlen(inst->text) > TEXT_WIDTH;
+    return snprintf(buf, size, "|%*.*s%s |%10ld |%10ld |%10ld |%10ld |",
+        cut ? TEXT_WIDTH - 1 : TEXT_WIDTH, cut ? TEXT_WIDTH - 1 : TEXT_WIDTH,
+        inst->text, cut ? "~" : "", inst->issue, inst->execute,
+        inst->writeback, inst->retired);
 }
 
 
@@ -65,6 +90,8 @@ struct ilist* create_inst_list(int initial_size) {
 
     list->size = initial_size;
     list->occupied = 0;
+    list->complete = false;
+    list->dropped = 0;
     list->data = malloc(initial_size * sizeof(struct instruction));
     if (list->data == NULL) {
         return NULL;
@@ -83,10 +110,7 @@ int add_inst(struct ilist* list, char* text) {
         return -1;
     }
 
-    // this struct initialization method requires C99
-    list->data[list->occupied] = (struct instruction){0};
-
-    int retval = _decode(list, list->occupied, text);
+    int retval = decode_inst(&list->data[list->occupied], text);
     if (!retval) {
         list->occupied++;
     }
@@ -94,6 +118,58 @@ int add_inst(struct ilist* list, char* text) {
 }
 
 
+int push_inst(struct ilist* list, struct instruction* inst) {
+    if (list->occupied == list->size) {
+        _grow(list);
+    }
+
+    if (list->occupied == list->size) {
+        // _grow failed, aborting
+        return -1;
+    }
+
+    list->data[list->occupied++] = *inst;
+    return 0;
+}
+
+
+int decode_inst(struct instruction* inst, char* text) {
+    // this struct initialization method requires C99
+    *inst = (struct instruction){0};
+
+    // strtok_r keeps decoding safe when several traces load concurrently
+    // the tokens are cut from a copy, on the stack for usual lengths
+    char local[128];
+    size_t length = strlen(text) + 1;
+    char* copy = (length <= sizeof(local)) ? local : malloc(length);
+    if (!copy) { return -1; }
+    memcpy(copy, text, length);
+
+    char* save;
+    char* elem = strtok_r(copy, " ,()", &save);
+    int retval = _decode(inst, elem, text, &save);
+    if (copy != local) {
+        free(copy);
+    }
+    return retval;
+}
+
+
+bool has_sources(struct instruction* inst) {
+    return inst->op != ld && inst->op != sw && inst->op != lv;
+}
+
+
+bool has_destination(struct instruction* inst) {
+    return inst->op != sv;
+}
+
+
+int reg_index(struct instruction* inst, int reg, int regfile_size) {
+    return (inst->opclass == vector) ? regfile_size + reg : reg >> 1;
+}
+
+
 static void _grow(struct ilist* list) {
     struct instruction* newlist = realloc(list->data, 
                             (list->size << 1) * sizeof(struct instruction));
@@ -108,32 +184,32 @@ static void _grow(struct ilist* list) {
 }
 
 
-static int _decode(struct ilist* list, int pos, char* text) { 
-    struct instruction* inst = &list->data[pos];
-
-    char* elem = malloc(strlen(text) + 1);
-    if (!elem) { return -1; }
-    strcpy(elem, text);
-
-    elem = strtok(elem, " ,()");
+static int _decode(struct instruction* inst, char* elem, char* text, char** save) { 
     if (elem != NULL) {
-        for (int i = 0; i < 6; i++) {
+        for (int i = 0; i < num_opcodes; i++) {
             if (!strcmp(elem, mnemonics[i])) {
                 inst->op = i;
                 inst->name = (char *) mnemonics[i];
-                inst->remaining = exec_cycles[i];
                 switch (i) {
                     case ld:
                     case sw:
-                        return _process_loadstore(inst, elem, text);
+                        inst->opclass = loadstore;
+                        return _process_loadstore(inst, save, text, 'F');
                     case addd:
                     case subd:
                         inst->opclass = addsub;
-                        return _process_arithmetic(inst, elem, text);
+                        return _process_arithmetic(inst, save, text, 'F');
                     case muld:
                     case divd:
                         inst->opclass = muldiv;
-                        return _process_arithmetic(inst, elem, text);
+                        return _process_arithmetic(inst, save, text, 'F');
+                    case lv:
+                    case sv:
+                        inst->opclass = vector;
+                        return _process_loadstore(inst, save, text, 'V');
+                    default:
+                        inst->opclass = vector;
+                        return _process_arithmetic(inst, save, text, 'V');
                 }
             }
         }
@@ -142,9 +218,16 @@ static int _decode(struct ilist* list, int pos, char* text) {
 }
 
 
-static int _process_loadstore(struct instruction* inst, char* elem, char* text) {
-    inst->opclass = loadstore;
-    if (_assign_register(&inst->rd, elem) != 0) { return -2; }
+static int _process_loadstore(struct instruction* inst, char** save, char* text,
+                              char prefix) {
+    if (inst->op == sv) {
+        // the stored vector is read as both operands, it is chained from
+        // its producer like the source of any vector instruction
+        if (_assign_register(&inst->rs1, save, prefix) != 0) { return -2; }
+        inst->rs2 = inst->rs1;
+    } else if (_assign_register(&inst->rd, save, prefix) != 0) {
+        return -2;
+    }
     if (_copy_inst_string(inst, text) != 0)     { return -3; }
 
     // No other information is required to simulate loads and store
@@ -152,18 +235,20 @@ static int _process_loadstore(struct instruction* inst, char* elem, char* text)
 }
 
 
-static int _process_arithmetic(struct instruction* inst, char* elem, char* text) {
-    if (_assign_register(&inst->rd, elem)  != 0) { return -4; }
-    if (_assign_register(&inst->rs1, elem) != 0) { return -5; }
-    if (_assign_register(&inst->rs2, elem) != 0) { return -6; }
+static int _process_arithmetic(struct instruction* inst, char** save, char* text,
+                               char prefix) {
+    if (_assign_register(&inst->rd, save, prefix)  != 0) { return -4; }
+    if (_assign_register(&inst->rs1, save, prefix) != 0) { return -5; }
+    if (_assign_register(&inst->rs2, save, prefix) != 0) { return -6; }
     if (_copy_inst_string(inst, text) != 0) { return -7; }
     return 0;
 }
 
 
-static int _assign_register(int* regid, char* elem) {
-    elem = strtok(NULL, " ,()");
-    if (elem[0] == 'F') {
+static int _assign_register(int* regid, char** save, char prefix) {
+    // prefix is F for the scalar registers, V for the vector ones
+    char* elem = strtok_r(NULL, " ,()", save);
+    if (elem && elem[0] == prefix) {
         *regid = atoi(elem + 1);
         return 0;
     } else {
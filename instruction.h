@@ -24,16 +24,29 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
-enum opclasses {addsub, muldiv, loadstore};
-enum opcode {ld, sw, addd, subd, muld, divd};
+// vector instructions operate on registers V0, V1, ... of vector_length
+// elements (see machine.h), all of them executed by vector stations
+enum opclasses {addsub, muldiv, loadstore, vector, num_opclasses};
+enum opcode {ld, sw, addd, subd, muld, divd, lv, sv, addv, subv, mulv, divv,
+             num_opcodes};
+
+// names and default execution time of each opcode, ordered as enum opcode
+extern const char* mnemonics[];
+extern const int exec_cycles[];
+
+// names of execution unit types, ordered as enum opclasses
+extern const char* opclass_names[];
 
 struct instruction {
     char* text;
-    int issue;
-    int execute;
-    int writeback;
-    int retired;
+    long issue;             // cycles, 0 until the instruction gets there
+    long execute;
+    long writeback;
+    long retired;
+    bool shared_text;       // text of a repeated body, not freed with it
     int remaining;
+    int latency;            // execution cycles, set at issue
+    int station;            // index of the station it issued to
     enum opcode op;
     enum opclasses opclass;
     int rs1;
@@ -46,7 +59,8 @@ struct ilist {
     size_t size;
     size_t occupied;
     struct instruction *data;
-    bool complete;
+    bool complete;          // every instruction of the program is loaded
+    size_t dropped;         // retired instructions removed from the front
 };
 
 
@@ -83,11 +97,90 @@ struct ilist* create_inst_list(int initial_size);
 int add_inst(struct ilist* list, char* text);
 
 
+/****** push_inst ***********************************************************
+*   Append an already decoded instruction to an ilist
+*       
+*   Parameters : 
+*       struct ilist* list          : target ilist
+*       struct instruction* inst    : decoded instruction, copied
+*
+*   Return : 0 if succesfull, non-zero otherwise
+*
+*   Side effects : 
+*           as add_inst. Growing the list moves its data : pointers to
+*           instructions of the list must then be updated.
+*****************************************************************************/
+int push_inst(struct ilist* list, struct instruction* inst);
+
+
+/****** decode_inst *********************************************************
+*   Decode the source text of an instruction
+*       
+*   Parameters : 
+*       struct instruction* inst    : instruction to fill
+*       char* text                  : source text of the instruction
+*
+*   Return : 0 if succesfull, non-zero otherwise (same codes as add_inst)
+*
+*   Side effects : 
+*           inst is overwritten, memory for a copy of text is allocated.
+*           safe to call from several threads at once.
+*****************************************************************************/
+int decode_inst(struct instruction* inst, char* text);
+
+
+/****** has_sources *********************************************************
+*   Tell whether an instruction waits for source registers. Loads and
+*   scalar stores only name the register they write or read in memory, a
+*   vector store reads its register as both rs1 and rs2.
+*       
+*   Parameters : 
+*       struct instruction* inst    : decoded instruction
+*
+*   Return : true if rs1 and rs2 are operands of the instruction
+*
+*   Side effects : none
+*****************************************************************************/
+bool has_sources(struct instruction* inst);
+
+
+/****** has_destination *****************************************************
+*   Tell whether an instruction renames rd. A vector store writes no
+*   register.
+*       
+*   Parameters : 
+*       struct instruction* inst    : decoded instruction
+*
+*   Return : true if rd is written by the instruction
+*
+*   Side effects : none
+*****************************************************************************/
+bool has_destination(struct instruction* inst);
+
+
+/****** reg_index ***********************************************************
+*   Find the register Q of a register of an instruction. Register Qs hold
+*   the scalar registers (F0, F2, ... share index n >> 1) followed by the
+*   vector registers.
+*       
+*   Parameters : 
+*       struct instruction* inst    : decoded instruction
+*       int reg                     : inst->rd, inst->rs1 or inst->rs2
+*       int regfile_size            : scalar registers of the machine
+*
+*   Return : index of the register Q
+*
+*   Side effects : none
+*****************************************************************************/
+int reg_index(struct instruction* inst, int reg, int regfile_size);
+
+
 /****** print_isnt **********************************************************
 *   Display information about an instruction in a format that is compatible with
 *    then following header :
 *   "| Instruction         | Issue     | Execute   | Writeback | Retired   |"
-*       
+*   A text longer than its column is cut, its last character shown as '~'
+*
 *   Parameters : 
 *       struct instruction* inst    : the instruction to display
 *
@@ -99,6 +192,23 @@ int add_inst(struct ilist* list, char* text);
 void print_inst(struct instruction* inst);
 
 
+/****** format_inst *********************************************************
+*   Same as print_inst, but the line is written to a buffer instead of the
+*   terminal (without trailing newline)
+*       
+*   Parameters : 
+*       char* buf                   : destination buffer
+*       size_t size                 : size of buf
+*       struct instruction* inst    : the instruction to display
+*
+*   Return : number of characters of the complete line, as snprintf
+*
+*   Side effects : 
+*           buf is modified
+*****************************************************************************/
+int format_inst(char* buf, size_t size, struct instruction* inst);
+
+
 /****** inst_details ********************************************************
 *   Display complete information about an instruction for debugging
 *       
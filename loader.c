@@ -0,0 +1,465 @@
+/****** loader.c ************************************************************
+*   Description
+*       Trace loading on a separate thread, overlapped with the simulation,
+*       for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "loader.h"
+
+#define LINE_LENGTH     256
+
+static void* _produce(void* arg);
+static int _fetch_inline(struct loader* l, struct state* s, struct thread* t);
+static int _next_inst(struct loader* l, struct instruction* inst);
+static int _start_repeat(struct loader* l, char* header);
+static int _decode_body(struct loader* l, long rename);
+static void _free_body(struct loader* l);
+static void _rename(char* renamed, size_t size, const char* text, long offset,
+                    int regs);
+static void _push(struct ring* r, struct instruction* inst);
+static void _consumed(struct ring* r, size_t head);
+static void _wait_filled(struct ring* r, size_t tail);
+static void _wake(struct ring* r, atomic_bool* waiting, pthread_cond_t* cond);
+
+
+int start_loader(struct loader* l, const char* filename, int regfile_size) {
+    // this struct initialization method requires C99
+    *l = (struct loader){0};
+    l->filename = filename;
+    l->regfile_size = regfile_size;
+
+    l->ring.slots = malloc(RING_CAPACITY * sizeof(struct instruction));
+    if (!l->ring.slots) {
+        return -1;
+    }
+    l->ring.mask = RING_CAPACITY - 1;
+    atomic_init(&l->ring.head, 0);
+    atomic_init(&l->ring.tail, 0);
+    atomic_init(&l->ring.done, false);
+    atomic_init(&l->ring.producer_waiting, false);
+    atomic_init(&l->ring.consumer_waiting, false);
+
+    // open here so that a missing file is reported before simulating
+    l->source = fopen(filename, "rt");
+    if (!l->source) {
+        return -1;
+    }
+
+    // with a single processor the two threads could only take turns,
+    // decoding is then done by the simulation itself, as it needs it
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+        return 0;
+    }
+    pthread_mutex_init(&l->ring.lock, NULL);
+    pthread_cond_init(&l->ring.space, NULL);
+    pthread_cond_init(&l->ring.filled, NULL);
+    if (pthread_create(&l->thread, NULL, _produce, l)) {
+        fclose(l->source);
+        return -1;
+    }
+    l->running = true;
+    return 0;
+}
+
+
+int loader_fetch(struct loader* l, struct state* s, struct thread* t) {
+    struct ring* r = &l->ring;
+
+    if (t->program->complete) {
+        return 0;
+    }
+    if (!l->running) {
+        return _fetch_inline(l, s, t);
+    }
+
+    for (;;) {
+        // leave the rest in the ring while there is enough to issue, a
+        // repeated body is then never expanded far ahead of the simulation
+        if (t->next + r->mask < t->program->occupied) {
+            return 0;
+        }
+
+        // done is read before tail : once done is seen, tail is final
+        bool done = atomic_load_explicit(&r->done, memory_order_acquire);
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+        for (; head != tail; head++) {
+            int result = append_inst(s, t, &r->slots[head & r->mask]);
+            if (result) {
+                _consumed(r, head);
+                return result;
+            }
+        }
+        _consumed(r, head);
+
+        if (done) {
+            pthread_join(l->thread, NULL);
+            l->running = false;
+            pthread_mutex_destroy(&r->lock);
+            pthread_cond_destroy(&r->space);
+            pthread_cond_destroy(&r->filled);
+            free(r->slots);
+            r->slots = NULL;
+            t->program->complete = true;
+            return l->error;
+        }
+
+        // keep going while there is something to issue
+        if (t->next < t->program->occupied) {
+            return 0;
+        }
+        _wait_filled(r, tail);
+    }
+}
+
+
+int load_trace(const char* filename, int regfile_size, struct ilist* program,
+               long* line) {
+    struct loader l = {.regfile_size = regfile_size, .own_texts = true};
+    struct instruction inst;
+    int result;
+
+    l.source = fopen(filename, "rt");
+    if (!l.source) {
+        return -1;
+    }
+    while ((result = _next_inst(&l, &inst)) > 0) {
+        if (push_inst(program, &inst)) {
+            free(inst.text);
+            result = -1;
+            l.error = -1;
+            break;
+        }
+    }
+    fclose(l.source);
+    _free_body(&l);
+
+    *line = l.line;
+    if (result < 0) {
+        return l.error;
+    }
+    program->complete = true;
+    return 0;
+}
+
+
+static void* _produce(void* arg) {
+    struct loader* l = arg;
+    struct instruction inst;
+
+    while (_next_inst(l, &inst) > 0) {
+        _push(&l->ring, &inst);
+    }
+    fclose(l->source);
+    _free_body(l);
+
+    // decoding is overlapped with the simulation, only the profile of the
+    // simulation thread would miss it
+    struct timespec cpu;
+    if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu)) {
+        l->decode_time = cpu.tv_sec + cpu.tv_nsec * 1e-9;
+    }
+
+    // error and every slot written are visible once done is
+    atomic_store(&l->ring.done, true);
+    pthread_mutex_lock(&l->ring.lock);
+    pthread_cond_signal(&l->ring.filled);
+    pthread_mutex_unlock(&l->ring.lock);
+    return NULL;
+}
+
+
+static int _fetch_inline(struct loader* l, struct state* s, struct thread* t) {
+    // only decode when the thread is about to run out of instructions,
+    // a ring's worth at a time
+    struct instruction inst;
+    int result = 1;
+
+    if (t->next + l->ring.mask < t->program->occupied) {
+        return 0;
+    }
+    for (size_t n = 0; n <= l->ring.mask && (result = _next_inst(l, &inst)) > 0; n++) {
+        int appended = append_inst(s, t, &inst);
+        if (appended) {
+            return appended;
+        }
+    }
+    if (result <= 0) {
+        fclose(l->source);
+        _free_body(l);
+        free(l->ring.slots);
+        l->ring.slots = NULL;
+        t->program->complete = true;
+        return l->error;
+    }
+    return 0;
+}
+
+
+static int _next_inst(struct loader* l, struct instruction* inst) {
+    // read and decode the next instruction of the trace, or copy the next
+    // one of a repeated body
+    // return 1 if an instruction was decoded, 0 at the end of the trace,
+    // -1 if it cannot be decoded (l->error and l->line are set)
+    struct repeat* r = &l->repeat;
+    char buffer[LINE_LENGTH];
+
+    for (;;) {
+        if (r->iteration < r->count) {
+            *inst = r->body[(r->iteration % r->period) * r->length + r->pos];
+            if (++r->pos == r->length) {
+                r->pos = 0;
+                r->iteration++;
+            }
+            if (l->own_texts && !(inst->text = strdup(inst->text))) {
+                l->error = -1;
+                return -1;
+            }
+            inst->shared_text = !l->own_texts;
+            return 1;
+        }
+
+        if (!fgets(buffer, sizeof(buffer), l->source)) {
+            return 0;
+        }
+        l->line++;
+        buffer[strcspn(buffer, "\r\n")] = '\0';     // remove trailing newline
+        char* start = buffer + strspn(buffer, " \t");
+        if (start[0] == '\0') {
+            // blank line
+            continue;
+        }
+
+        int result;
+        if (!strncmp(start, "repeat", 6) && strchr(" \t", start[6])) {
+            // the first copy is made by the next pass of the loop
+            result = _start_repeat(l, start);
+        } else if ((result = decode_inst(inst, buffer)) == 0) {
+            return 1;
+        }
+        if (result) {
+            l->error = result;
+            return -1;
+        }
+    }
+}
+
+
+static int _start_repeat(struct loader* l, char* header) {
+    // parse "repeat N [rename K] {", then read and decode the body up to
+    // the closing "}"
+    struct repeat* r = &l->repeat;
+    char buffer[LINE_LENGTH];
+    char* save;
+    char* end;
+    long rename = 0;
+
+    strtok_r(header, " \t", &save);
+    char* elem = strtok_r(NULL, " \t", &save);
+    long count = elem ? strtol(elem, &end, 10) : -1;
+    if (!elem || *end || count < 0) {
+        return REPEAT_SYNTAX;
+    }
+    elem = strtok_r(NULL, " \t", &save);
+    if (elem && !strcmp(elem, "rename")) {
+        elem = strtok_r(NULL, " \t", &save);
+        rename = elem ? strtol(elem, &end, 10) : 1;
+        if (!elem || *end || rename % 2) {
+            return REPEAT_RENAME;
+        }
+        elem = strtok_r(NULL, " \t", &save);
+    }
+    if (!elem || strcmp(elem, "{") || strtok_r(NULL, " \t", &save)) {
+        return REPEAT_SYNTAX;
+    }
+
+    _free_body(l);
+    r->length = 0;
+    r->pos = 0;
+    r->iteration = 0;
+    r->count = 0;
+
+    while (fgets(buffer, sizeof(buffer), l->source)) {
+        l->line++;
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        char* start = buffer + strspn(buffer, " \t");
+        if (start[0] == '\0') {
+            continue;
+        }
+        if (!strcmp(start, "}")) {
+            // an empty body repeats nothing
+            r->count = r->length ? count : 0;
+            return _decode_body(l, rename);
+        }
+        if (!strncmp(start, "repeat", 6)) {
+            return REPEAT_SYNTAX;
+        }
+
+        if (r->length == r->size) {
+            size_t new_size = r->size ? r->size << 1 : 16;
+            struct instruction* body = realloc(r->body,
+                                        new_size * sizeof(struct instruction));
+            if (!body) {
+                return -1;
+            }
+            r->body = body;
+            r->size = new_size;
+        }
+        int result = decode_inst(&r->body[r->length], start);
+        if (result) {
+            return result;
+        }
+        r->length++;
+        r->period = 1;
+    }
+    return REPEAT_UNTERMINATED;
+}
+
+
+static int _decode_body(struct loader* l, long rename) {
+    // decode the renamed body of each iteration, up to the one whose
+    // registers are back to those of the first
+    struct repeat* r = &l->repeat;
+    int regs = l->regfile_size << 1;
+    long offset = ((rename % regs) + regs) % regs;
+    long a = regs;
+    long b = offset;
+
+    // period = regs / gcd(offset, regs)
+    while (b) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    long period = regs / a;
+
+    if (period * r->length > r->size) {
+        struct instruction* body = realloc(r->body,
+                                    period * r->length * sizeof(struct instruction));
+        if (!body) {
+            return -1;
+        }
+        r->body = body;
+        r->size = period * r->length;
+    }
+
+    // period only counts the decoded iterations, for _free_body
+    for (; r->period < period; r->period++) {
+        for (size_t i = 0; i < r->length; i++) {
+            char renamed[2 * LINE_LENGTH];
+            _rename(renamed, sizeof(renamed), r->body[i].text,
+                    r->period * offset, regs);
+            if (decode_inst(&r->body[r->period * r->length + i], renamed)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+static void _free_body(struct loader* l) {
+    // copies share the texts of the body, unless they own a copy
+    struct repeat* r = &l->repeat;
+    if (l->own_texts) {
+        for (size_t i = 0; i < r->period * r->length; i++) {
+            free(r->body[i].text);
+        }
+    }
+    free(r->body);
+    r->body = NULL;
+    r->size = 0;
+    r->period = 0;
+}
+
+
+static void _rename(char* renamed, size_t size, const char* text, long offset,
+                    int regs) {
+    // copy text, adding offset to the number of every register Fn within
+    // the register file, modulo its size
+    size_t length = 0;
+
+    while (*text && length + 1 < size) {
+        bool reg = *text == 'F' && isdigit((unsigned char) text[1]) &&
+                   (length == 0 || strchr(" \t,(", renamed[length - 1]));
+        if (!reg) {
+            renamed[length++] = *text++;
+            continue;
+        }
+        char* end;
+        long n = strtol(text + 1, &end, 10);
+        if (n < regs) {
+            n = (n + offset) % regs;
+        }
+        length += snprintf(renamed + length, size - length, "F%ld", n);
+        text = end;
+    }
+    renamed[length < size ? length : size - 1] = '\0';
+}
+
+
+static void _push(struct ring* r, struct instruction* inst) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    // backpressure : sleep until the simulation makes room. The flag is
+    // raised before head is read again, so either the new head is seen or
+    // the simulation sees the flag and signals
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) > r->mask) {
+        pthread_mutex_lock(&r->lock);
+        atomic_store(&r->producer_waiting, true);
+        while (tail - atomic_load(&r->head) > r->mask) {
+            pthread_cond_wait(&r->space, &r->lock);
+        }
+        atomic_store(&r->producer_waiting, false);
+        pthread_mutex_unlock(&r->lock);
+    }
+    r->slots[tail & r->mask] = *inst;
+    atomic_store(&r->tail, tail + 1);
+    _wake(r, &r->consumer_waiting, &r->filled);
+}
+
+
+static void _consumed(struct ring* r, size_t head) {
+    atomic_store(&r->head, head);
+    _wake(r, &r->producer_waiting, &r->space);
+}
+
+
+static void _wait_filled(struct ring* r, size_t tail) {
+    // the simulation has nothing left to issue : sleep until the loader
+    // produces past tail or reaches the end of the trace
+    pthread_mutex_lock(&r->lock);
+    atomic_store(&r->consumer_waiting, true);
+    while (atomic_load(&r->tail) == tail && !atomic_load(&r->done)) {
+        pthread_cond_wait(&r->filled, &r->lock);
+    }
+    atomic_store(&r->consumer_waiting, false);
+    pthread_mutex_unlock(&r->lock);
+}
+
+
+static void _wake(struct ring* r, atomic_bool* waiting, pthread_cond_t* cond) {
+    // the lock is held by the sleeper from its last check until it sleeps
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&r->lock);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(&r->lock);
+    }
+}
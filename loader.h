@@ -0,0 +1,155 @@
+/****** loader.h ************************************************************
+*   Description
+*       Trace loading on a separate thread, overlapped with the simulation,
+*       for Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "instruction.h"
+#include "tomasulo.h"
+
+#define RING_CAPACITY   4096    // must be a power of 2
+#define CACHE_LINE      64
+
+// error codes of the repeat construct, beside those of add_inst
+#define REPEAT_SYNTAX       -11     // not "repeat N [rename K] {", or nested
+#define REPEAT_UNTERMINATED -12     // no "}" before the end of the trace
+#define REPEAT_RENAME       -13     // K is not an even register offset
+
+// Single producer / single consumer ring of decoded instructions.
+// The producer (loader thread) only writes tail, the consumer (simulation)
+// only writes head; each index lives on its own cache line. A side that
+// cannot go on (ring full, or empty while the simulation needs an
+// instruction) sleeps on a condition, after raising its waiting flag : the
+// other side only takes the lock to wake it when the flag is up.
+struct ring {
+    struct instruction* slots;
+    size_t mask;
+    _Alignas(CACHE_LINE) atomic_size_t head;   // next slot to read
+    _Alignas(CACHE_LINE) atomic_size_t tail;   // next slot to write
+    _Alignas(CACHE_LINE) atomic_bool done;     // no more instructions
+    atomic_bool producer_waiting;
+    atomic_bool consumer_waiting;
+    pthread_mutex_t lock;                      // only to sleep on
+    pthread_cond_t space;                      // head moved
+    pthread_cond_t filled;                     // tail moved or done
+};
+
+// A trace may hold
+//      repeat N [rename K] {
+//          instructions
+//      }
+// The body is decoded once and copies are produced as the simulation
+// needs them, never stored all at once. With rename, register numbers
+// grow by K (even, F0 -> FK) at each iteration, wrapping around the
+// register file of the machine.
+struct repeat {
+    struct instruction* body;   // decoded once per iteration of a period
+    size_t length;              // instructions in the body
+    size_t size;
+    long period;                // iterations before the renaming wraps
+    long count;
+    long iteration;             // of the next copy
+    size_t pos;                 // of the next copy in the body
+};
+
+struct loader {
+    struct ring ring;
+    pthread_t thread;
+    bool running;               // false if decoding inline, see start_loader
+    const char* filename;
+    FILE* source;
+    int error;                  // add_inst error code, read once done
+    long line;                  // lines read, line of the error once done
+    int regfile_size;           // of the machine, for renaming
+    bool own_texts;             // each copy gets its own text
+    double decode_time;         // CPU seconds of the thread, once joined
+    struct repeat repeat;
+};
+
+
+/****** start_loader ********************************************************
+*   Open a trace and start decoding it on a new thread. On a single
+*   processor host no thread is started, loader_fetch decodes the trace
+*   itself as the simulation needs it.
+*       
+*   Parameters : 
+*       struct loader* l        : loader to start
+*       const char* filename    : trace to decode
+*       int regfile_size        : register Qs of the machine
+*
+*   Return : 0 if succesfull, non-zero if the file cannot be opened or the
+*            thread cannot be created
+*
+*   Side effects : 
+*           memory for the ring is allocated, a thread is started
+*****************************************************************************/
+int start_loader(struct loader* l, const char* filename, int regfile_size);
+
+
+/****** loader_fetch ********************************************************
+*   Move the instructions decoded so far to the program of a thread,
+*   once fewer than a ring of them are left to issue : the loader is
+*   then held back by the ring instead of running ahead of the trace.
+*   If the thread has nothing left to issue, wait for the loader to
+*   produce at least one instruction or to reach the end of the trace.
+*       
+*   Parameters : 
+*       struct loader* l        : loader of the thread
+*       struct state* s         : current simulation context
+*       struct thread* t        : thread receiving the instructions
+*
+*   Return : 0 if succesfull, 
+*            -1 if memory allocation fails
+*            -2 if an instruction uses registers beyond s->regfile_size
+*            l->error if the trace cannot be decoded (see l->line)
+*
+*   Side effects : 
+*           instructions are appended to the program, program->complete is
+*           set and the loader thread joined at the end of the trace
+*****************************************************************************/
+int loader_fetch(struct loader* l, struct state* s, struct thread* t);
+
+
+/****** load_trace **********************************************************
+*   Decode a whole trace at once, on the calling thread. Repeated
+*   instructions are all stored, each with its own text.
+*       
+*   Parameters : 
+*       const char* filename    : trace to decode
+*       int regfile_size        : register Qs of the machine
+*       struct ilist* program   : list receiving the instructions
+*       long* line              : line of the error, if the trace cannot be
+*                                 decoded
+*
+*   Return : 0 if succesfull, 
+*            -1 if the file cannot be opened or memory allocation fails
+*            add_inst or REPEAT_ error code if the trace cannot be decoded
+*
+*   Side effects : 
+*           instructions are appended to the program, program->complete is
+*           set if the whole trace was decoded
+*****************************************************************************/
+int load_trace(const char* filename, int regfile_size, struct ilist* program,
+               long* line);
+
+#endif
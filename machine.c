@@ -0,0 +1,229 @@
+/****** machine.c ***********************************************************
+*   Description
+*       Machine description (stations, latencies, widths) for Tomasulo's
+*       algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "machine.h"
+#include "tomasulo.h"
+
+// ordered as enum distribution_kind
+const char* distribution_names[] = {"constant", "uniform", "normal", "exponential"};
+
+static int _parse_line(struct machine* m, char* line, bool* stations_given);
+static int _parse_variation(struct machine* m, char* op, char* kind, char* a,
+                            char* b);
+static int _lookup(const char* names[], int count, const char* name);
+static int _add_group(struct machine* m, const char* prefix,
+                      enum opclasses type, int count);
+
+
+void default_machine(struct machine* m) {
+    // this struct initialization method requires C99
+    *m = (struct machine){0};
+    m->issue_width = 1;
+    m->regfile_size = 8;
+    m->vector_length = 64;
+    m->lanes = 8;
+    for (int i = 0; i < num_opcodes; i++) {
+        m->latency[i] = exec_cycles[i];
+    }
+    _add_group(m, "Add", addsub, 3);
+    _add_group(m, "Mul", muldiv, 2);
+    _add_group(m, "Load", loadstore, 2);
+}
+
+
+#ifdef TOMASULO_FIXED
+void fixed_machine(struct machine* m) {
+    static const int latency[] = FIXED_LATENCIES;
+    static const struct station_group groups[] = FIXED_STATION_GROUPS;
+
+    *m = (struct machine){0};
+    m->issue_width = FIXED_ISSUE_WIDTH;
+    m->regfile_size = FIXED_REGFILE_SIZE;
+    m->vregfile_size = FIXED_VREGFILE_SIZE;
+    m->vector_length = FIXED_VECTOR_LENGTH;
+    m->lanes = FIXED_LANES;
+    memcpy(m->latency, latency, sizeof(m->latency));
+    memcpy(m->groups, groups, sizeof(groups));
+    static const struct distribution variation[num_opcodes] = FIXED_VARIATIONS;
+    memcpy(m->variation, variation, sizeof(m->variation));
+    m->num_groups = FIXED_NUM_GROUPS;
+}
+#endif
+
+
+int load_machine(const char* filename, struct machine* m) {
+    char buffer[128];
+    bool stations_given = false;
+    int line_number = 0;
+
+    default_machine(m);
+
+    FILE *source = fopen(filename, "rt");
+    if (!source) {
+        return -1;
+    }
+
+    while (fgets(buffer, sizeof(buffer), source)) {
+        line_number++;
+        if (_parse_line(m, buffer, &stations_given)) {
+            fclose(source);
+            return line_number;
+        }
+    }
+    fclose(source);
+
+    // every class of instruction needs somewhere to go, or issue stalls
+    // forever. vector instructions only exist with vector registers
+    for (int type = 0; type < num_opclasses; type++) {
+        int found = 0;
+        for (int g = 0; g < m->num_groups; g++) {
+            found |= (m->groups[g].type == (enum opclasses) type);
+        }
+        if (type == vector ? found != (m->vregfile_size > 0) : !found) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+int build_stations(struct machine* m, struct slist* stations) {
+    char name[MAX_PREFIX + 12];
+
+    for (int g = 0; g < m->num_groups; g++) {
+        for (int i = 1; i <= m->groups[g].count; i++) {
+            snprintf(name, sizeof(name), "%s%d", m->groups[g].prefix, i);
+            if (add_station(stations, name, m->groups[g].type)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+
+static int _parse_line(struct machine* m, char* line, bool* stations_given) {
+    char* comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+
+    char* key = strtok(line, " \t\r\n");
+    if (!key) {
+        // blank line
+        return 0;
+    }
+    char* arg1 = strtok(NULL, " \t\r\n");
+    char* arg2 = strtok(NULL, " \t\r\n");
+    char* arg3 = strtok(NULL, " \t\r\n");
+    char* arg4 = strtok(NULL, " \t\r\n");
+
+    if (!strcmp(key, "issue_width") && arg1) {
+        m->issue_width = atoi(arg1);
+        return (m->issue_width < 1);
+    }
+    if (!strcmp(key, "registers") && arg1) {
+        m->regfile_size = atoi(arg1);
+        return (m->regfile_size < 1);
+    }
+    if (!strcmp(key, "vector_registers") && arg1) {
+        m->vregfile_size = atoi(arg1);
+        return (m->vregfile_size < 1);
+    }
+    if (!strcmp(key, "vector_length") && arg1) {
+        m->vector_length = atoi(arg1);
+        return (m->vector_length < 1);
+    }
+    if (!strcmp(key, "lanes") && arg1) {
+        m->lanes = atoi(arg1);
+        return (m->lanes < 1);
+    }
+    if (!strcmp(key, "latency") && arg2) {
+        int op = _lookup(mnemonics, num_opcodes, arg1);
+        if (op < 0 || atoi(arg2) < 1) {
+            return -1;
+        }
+        m->latency[op] = atoi(arg2);
+        return 0;
+    }
+    if (!strcmp(key, "variation") && arg4) {
+        return _parse_variation(m, arg1, arg2, arg3, arg4);
+    }
+    if (!strcmp(key, "station") && arg3) {
+        int type = _lookup(opclass_names, num_opclasses, arg2);
+        if (type < 0 || atoi(arg3) < 1 || strlen(arg1) >= MAX_PREFIX) {
+            return -1;
+        }
+        if (!*stations_given) {
+            // the file describes its own set of stations
+            m->num_groups = 0;
+            *stations_given = true;
+        }
+        return _add_group(m, arg1, type, atoi(arg3));
+    }
+    return -1;
+}
+
+
+static int _parse_variation(struct machine* m, char* op, char* kind, char* a,
+                            char* b) {
+    int i = _lookup(mnemonics, num_opcodes, op);
+    int k = _lookup(distribution_names, num_distributions, kind);
+    char* end_a;
+    char* end_b;
+    double low = strtod(a, &end_a);
+    double high = strtod(b, &end_b);
+
+    if (i < 0 || k <= constant || *end_a || *end_b) {
+        return -1;
+    }
+    // latencies are at least one cycle, a uniform range must hold a whole
+    // number of cycles
+    if (low < 1 || high < ((k == normal) ? 0 : low) ||
+            (k == uniform && floor(high) < ceil(low))) {
+        return -1;
+    }
+    m->variation[i] = (struct distribution){k, low, high};
+    return 0;
+}
+
+
+static int _lookup(const char* names[], int count, const char* name) {
+    for (int i = 0; i < count; i++) {
+        if (!strcmp(names[i], name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+static int _add_group(struct machine* m, const char* prefix,
+                      enum opclasses type, int count) {
+    if (m->num_groups == MAX_STATION_GROUPS) {
+        return -1;
+    }
+    struct station_group* g = &m->groups[m->num_groups++];
+    strcpy(g->prefix, prefix);
+    g->type = type;
+    g->count = count;
+    return 0;
+}
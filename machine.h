@@ -0,0 +1,144 @@
+/****** machine.h ***********************************************************
+*   Description
+*       Machine description (stations, latencies, widths) for Tomasulo's
+*       algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include "instruction.h"
+#include "station.h"
+
+#define MAX_STATION_GROUPS  16
+#define MAX_PREFIX          8
+
+// latency of an opcode in Monte Carlo runs (see montecarlo.h), the
+// latency of the machine when constant
+enum distribution_kind {constant, uniform, normal, exponential, num_distributions};
+
+// names of the distributions, ordered as enum distribution_kind
+extern const char* distribution_names[];
+
+struct distribution {
+    enum distribution_kind kind;
+    double a;                   // uniform : min, normal : mean, exponential : min
+    double b;                   // uniform : max, normal : deviation, exponential : mean
+};
+
+// a group of identical reservation stations, named prefix1, prefix2, ...
+struct station_group {
+    char prefix[MAX_PREFIX];
+    enum opclasses type;
+    int count;
+};
+
+// Vector stations execute lanes elements per cycle : a vector instruction
+// keeps its unit latency + ceil(vector_length / lanes) - 1 cycles. A
+// vector operand is chained, read as its first elements are produced
+// instead of once the whole vector is written back.
+struct machine {
+    int issue_width;
+    int regfile_size;
+    int vregfile_size;          // 0 : no vector instructions
+    int vector_length;          // elements of a vector register
+    int lanes;                  // elements per cycle of a vector unit
+    int latency[num_opcodes];
+    struct distribution variation[num_opcodes];
+    struct station_group groups[MAX_STATION_GROUPS];
+    int num_groups;
+};
+
+
+/****** default_machine *****************************************************
+*   Describe the machine of the original demo : 3 add/sub, 2 mul/div and
+*   2 load/store stations, single issue, 8 registers, exec_cycles latencies,
+*   no vector registers (vectors of 64 elements, 8 lanes once described)
+*       
+*   Parameters : 
+*       struct machine* m       : description to fill
+*
+*   Return : none
+*
+*   Side effects : 
+*           m is modified
+*****************************************************************************/
+void default_machine(struct machine* m);
+
+
+/****** fixed_machine *******************************************************
+*   Describe the machine compiled into the specialized engine
+*   (only available when built with TOMASULO_FIXED)
+*       
+*   Parameters : 
+*       struct machine* m       : description to fill
+*
+*   Return : none
+*
+*   Side effects : 
+*           m is modified
+*****************************************************************************/
+#ifdef TOMASULO_FIXED
+void fixed_machine(struct machine* m);
+#endif
+
+
+/****** load_machine ********************************************************
+*   Read a machine description. Each line holds one directive, '#' starts
+*   a comment :
+*       issue_width <n>
+*       registers <n>
+*       vector_registers <n>
+*       vector_length <n>
+*       lanes <n>
+*       station <prefix> <addsub|muldiv|loadstore|vector> <count>
+*       latency <mnemonic> <cycles>
+*       variation <mnemonic> uniform <min> <max>
+*       variation <mnemonic> normal <mean> <deviation>
+*       variation <mnemonic> exponential <min> <mean>
+*   Variations only apply to Monte Carlo runs. A uniform variation draws
+*   whole cycles, its range must hold at least one.
+*   Directives absent from the file keep the values of default_machine,
+*   except stations : if any is given, they replace the default ones.
+*   Vector stations and vector registers go together.
+*       
+*   Parameters : 
+*       const char* filename    : machine description file
+*       struct machine* m       : description to fill
+*
+*   Return : 0 if succesfull, line number of the first error otherwise,
+*            -1 if the file cannot be opened or the machine is incomplete
+*
+*   Side effects : 
+*           m is modified
+*****************************************************************************/
+int load_machine(const char* filename, struct machine* m);
+
+
+/****** build_stations ******************************************************
+*   Create the reservation stations of a machine
+*       
+*   Parameters : 
+*       struct machine* m       : machine description
+*       struct slist* stations  : list receiving the stations
+*
+*   Return : 0 if succesfull, non-zero otherwise
+*
+*   Side effects : 
+*           stations are added to the list
+*****************************************************************************/
+int build_stations(struct machine* m, struct slist* stations);
+
+#endif
@@ -27,146 +27,656 @@
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <unistd.h>
 #include "instruction.h"
 #include "station.h"
 #include "tomasulo.h"
+#include "render.h"
+#include "profile.h"
+#include "machine.h"
+#include "memo.h"
+#include "loader.h"
+#include "analysis.h"
+#include "history.h"
+#include "server.h"
+#include "results.h"
+#include "montecarlo.h"
+#include "export.h"
+#include "registers.h"
 
 
-void print_banner();
-void print_scoreboard(struct ilist* program);
-void print_stations(struct slist* stations);
-void print_registers();
-int load_program(const char* filename, struct ilist* prog);
-void print_state(struct state* s, char* reg_names[]);
+#define MEMO_BLOCK 32
 
+// every block encodes the stations and register Qs, below this size the
+// encoding costs more than simulating the block
+#define MEMO_MIN_BLOCK 16
 
-int main(void) {
-     // arrays of strings for register names and content
-    char* reg_names[] = {"F0", "F2", "F4", "F6", "F8", "F10", "F12", "F14"};    
-    char* reg_contents[] = {"", "", "", "", "", "", "", ""};
-    char input;
+// kept on one line of the terminal, the display places the cursor after
+// it. The commands are described in README.md
+#define PROMPT "c/b/g/r/s/a ? "
 
-    // program loading
-    struct ilist* program = create_inst_list(10);
-    if (!program) {
-        puts("list creation failed");
+// interactive stepping : the simulation runs without display until the
+// cycle is reached or, if watch_thread is set, the instruction retires,
+// or, if watch_station is set, the station becomes busy.
+// Targets already simulated are reached from the history instead
+struct stepping {
+    long until_cycle;
+    int watch_thread;
+    size_t watch_inst;
+    int watch_station;
+};
+
+int fetch_programs(struct state* s, struct loader* loaders, char* traces[]);
+bool step_done(struct stepping* step, struct state* s, struct history* h);
+bool travel(struct stepping* step, struct state* s, struct history* h);
+int read_command(struct stepping* step, struct state* s);
+void usage(const char* prog);
+
+
+int main(int argc, char* argv[]) {
+    // command line parameters
+    static struct option long_options[] = {
+        {"batch",  no_argument,       NULL, 'b'},
+        {"policy", required_argument, NULL, 'p'},
+        {"width",  required_argument, NULL, 'w'},
+        {"machine", required_argument, NULL, 'm'},
+        {"profile", no_argument,      NULL, 'P'},
+        {"memo",   optional_argument, NULL, 'M'},
+        {"memo-verify", no_argument,  NULL, 'V'},
+        {"analyze", no_argument,      NULL, 'a'},
+        {"serve",  optional_argument, NULL, 'S'},
+        {"jobs",   required_argument, NULL, 'j'},
+        {"cache",  optional_argument, NULL, 'C'},
+        {"monte-carlo", optional_argument, NULL, 'R'},
+        {"seed",   required_argument, NULL, 'E'},
+        {"export", required_argument, NULL, 'X'},
+        {"help",   no_argument,       NULL, 'h'},
+        {NULL, 0, NULL, 0}
+    };
+    bool batch = false;
+    enum fetch_policy policy = round_robin;
+    int issue_width = 0;
+    const char* machine_file = NULL;
+    int memo_block = 0;
+    bool memo_verify = false;
+    bool profiling = false;
+    bool analyze = false;
+    const char* serve = NULL;
+    int workers = 0;
+    char* cache_dir = NULL;
+    bool caching = false;
+    int replicas = 0;
+    uint64_t seed = 1;
+    const char* export_file = NULL;
+    struct profile prof;
+    uint64_t t;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "bp:w:m:Paj:h", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'b':
+                batch = true;
+                break;
+            case 'p':
+                if (!strcmp(optarg, "rr")) {
+                    policy = round_robin;
+                } else if (!strcmp(optarg, "icount")) {
+                    policy = icount;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'P':
+                profiling = true;
+                break;
+            case 'a':
+                analyze = true;
+                break;
+            case 'C':
+                caching = true;
+                cache_dir = optarg;
+                break;
+            case 'R':
+                replicas = optarg ? atoi(optarg) : MONTE_CARLO_REPLICAS;
+                if (replicas < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'E':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'X':
+                export_file = optarg;
+                break;
+            case 'S':
+                serve = optarg ? optarg : SERVER_SOCKET;
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                if (workers < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'm':
+                machine_file = optarg;
+                break;
+            case 'M':
+                memo_block = optarg ? atoi(optarg) : MEMO_BLOCK;
+                if (memo_block < MEMO_MIN_BLOCK) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'V':
+                memo_verify = true;
+                if (!memo_block) {
+                    memo_block = MEMO_BLOCK;
+                }
+                break;
+            case 'w':
+                issue_width = atoi(optarg);
+                if (issue_width < 1) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
     }
-    load_program("prog1.txt", program);
 
-    // create reservation stations
-    struct slist* stations = create_station_list(10);
-    add_station(stations, "Add1", addsub);
-    add_station(stations, "Add2", addsub);
-    add_station(stations, "Add3", addsub);
-    add_station(stations, "Mul1", muldiv);
-    add_station(stations, "Mul2", muldiv);
-    add_station(stations, "Load1", loadstore);
-    add_station(stations, "Load2", loadstore);
+    // jobs of the server are only answered with their summary
+    if (export_file && serve) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // blocks are only memoized for a single thread simulated in batch mode
+    if (memo_block) {
+        const char* reason = NULL;
+        if (serve) {
+            reason = "jobs of the server";
+        } else if (replicas) {
+            reason = "Monte Carlo replicas";
+        } else if (!batch) {
+            reason = "interactive runs";
+        } else if (argc - optind > 1) {
+            reason = "more than one thread";
+        }
+        if (reason) {
+            fprintf(stderr, "--memo ignored : not available for %s\n", reason);
+            memo_block = 0;
+        }
+    }
+
+    // results are only cached for batch runs and jobs of the server, a
+    // cached result has no timeline to export
+    if (export_file) {
+        caching = false;
+        cache_dir = NULL;
+    }
+    if (caching && (batch || serve) && !cache_dir) {
+        cache_dir = result_cache_dir();
+        if (!cache_dir) {
+            puts("no cache directory, set HOME or give --cache=DIR");
+            return 1;
+        }
+    } else if (!batch && !serve) {
+        cache_dir = NULL;
+    }
+
+    if (!workers) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = (cpus > 0) ? cpus : 1;
+    }
+
+    // jobs bring their own traces and machine
+    if (serve) {
+        return run_server(serve, workers, cache_dir);
+    }
+
+    // machine description
+    struct machine machine;
+#ifdef TOMASULO_FIXED
+    if (machine_file || issue_width) {
+        puts("this engine is specialized for a fixed machine, "
+             "-m and -w are not available");
+        return 1;
+    }
+    fixed_machine(&machine);
+#else
+    if (machine_file) {
+        int line = load_machine(machine_file, &machine);
+        if (line) {
+            printf("invalid machine description %s", machine_file);
+            if (line > 0) {
+                printf(", line %d", line);
+            }
+            puts("");
+            return 1;
+        }
+    } else {
+        default_machine(&machine);
+    }
+    if (issue_width) {
+        machine.issue_width = issue_width;
+    }
+#endif
+
+    // arrays of strings for register names
+    char** reg_names = register_names(machine.regfile_size, machine.vregfile_size);
+    if (!reg_names) {
+        puts("register creation failed");
+        return 1;
+    }
+
+    // each trace on the command line runs on its own hardware thread
+    char* default_trace[] = {"prog1.txt"};
+    char** traces = (optind < argc) ? &argv[optind] : default_trace;
+    int num_threads = (optind < argc) ? argc - optind : 1;
+
+    // replicas are simulated to completion, without any of the options
+    // of a single run
+    if (replicas) {
+        return run_monte_carlo(&machine, traces, num_threads, policy, replicas,
+                               seed, workers, reg_names);
+    }
 
     // init simulation state context
-    struct state context;
-    context.program = program;
+    struct state context = {0};
+    context.issue_width = machine.issue_width;
+    context.regfile_size = machine.regfile_size;
+    context.vregfile_size = machine.vregfile_size;
+    context.vector_cycles = (machine.vector_length + machine.lanes - 1) / machine.lanes;
+    context.latency = machine.latency;
+    context.policy = policy;
+    context.num_threads = num_threads;
+    context.threads = malloc(num_threads * sizeof(struct thread));
+    if (!context.threads) {
+        puts("thread creation failed");
+        return 1;
+    }
+
+    // program loading, each trace is decoded on its own thread while
+    // the simulation consumes it. The cache key needs whole traces, they
+    // are then decoded before simulating
+    profile_init(&prof, profiling);
+    struct loader* loaders = malloc(num_threads * sizeof(struct loader));
+    if (!loaders) {
+        puts("loader creation failed");
+        return 1;
+    }
+    for (int n = 0; n < num_threads; n++) {
+        struct ilist* program = create_inst_list(10);
+        if (!program) {
+            puts("list creation failed");
+            return 1;
+        }
+        if (cache_dir) {
+            long line = 0;
+            t = profile_begin(&prof);
+            int result = load_trace(traces[n], context.regfile_size, program, &line);
+            profile_end(&prof, stage_load, t);
+            loaders[n] = (struct loader){0};
+            if (result == -1) {
+                printf("could not load %s\n", traces[n]);
+                return 1;
+            } else if (result) {
+                printf("%s, line %ld : cannot decode instruction (code %d)\n",
+                    traces[n], line, result);
+                return 1;
+            }
+        } else if (start_loader(&loaders[n], traces[n], context.regfile_size)) {
+            printf("could not load %s\n", traces[n]);
+            return 1;
+        }
+        int result = init_thread(&context.threads[n], program, &context);
+        if (result == -2) {
+            printf("%s uses more than %d registers or %d vector registers\n",
+                traces[n], context.regfile_size, context.vregfile_size);
+            return 1;
+        } else if (result) {
+            puts("thread creation failed");
+            return 1;
+        }
+    }
+
+    // create reservation stations
+    struct slist* stations = create_station_list(10);
+    if (!stations || build_stations(&machine, stations)) {
+        puts("station creation failed");
+        return 1;
+    }
     context.stations = stations;
-    context.issue_width = 1;
-    context.regfile_size = 8;
 
+    // a result found in the cache leaves nothing to simulate
+    uint64_t key = 0;
+    bool cached = false;
+    if (cache_dir) {
+        key = result_key(&context);
+        cached = !result_lookup(cache_dir, key, &context);
+    }
+
+    // timing memoization of repeated blocks, in batch mode only
+    struct memo* memo = NULL;
+    if (batch && memo_block) {
+        memo = create_memo(memo_block, memo_verify, reg_names);
+        if (!memo) {
+            puts("memo creation failed");
+            return 1;
+        }
+    }
+
+    // critical path and bounds, computed as the traces are loaded
+    struct dataflow** analyses = NULL;
+    if (analyze) {
+        analyses = malloc(num_threads * sizeof(struct dataflow*));
+        if (!analyses) {
+            puts("analysis creation failed");
+            return 1;
+        }
+        for (int n = 0; n < num_threads; n++) {
+            analyses[n] = create_dataflow(&context);
+            if (!analyses[n]) {
+                puts("analysis creation failed");
+                return 1;
+            }
+        }
+    }
+
+    // timeline of every instruction, streamed as they retire
+    struct exporter* exporter = NULL;
+    if (export_file) {
+        exporter = create_exporter(export_file, num_threads);
+        if (!exporter) {
+            printf("could not create %s\n", export_file);
+            return 1;
+        }
+    }
+
+    // interactive display and stepping
+    struct render* display = NULL;
+    struct history* history = NULL;
+    struct stepping step = {.until_cycle = 1, .watch_thread = -1, .watch_station = -1};
+    if (!batch) {
+        display = create_renderer();
+        history = create_history(&context, reg_names);
+        if (!display || !history) {
+            puts("display creation failed");
+            return 1;
+        }
+    }
 
     // run simulation
-    for (context.cycle = 1; context.cycle < 100; context.cycle++) {
-        retire(&context, reg_contents);
-        issue(&context, reg_names, reg_contents);
+    if (!cached) {
+        context.cycle = 1;
+    }
+    for (; !context.complete; context.cycle++) {
+        // retired instructions are exported before compaction drops them
+        if (exporter && export_retired(exporter, &context)) {
+            printf("could not write to %s\n", export_file);
+            return 1;
+        }
+
+        // in batch mode nothing looks back at retired instructions, a
+        // memoized block in progress still needs them. The critical path
+        // of the analysis points to their texts
+        for (int n = 0; batch && !analyze && n < num_threads; n++) {
+            if (!(memo && memo->recording)) {
+                compact_thread(&context, &context.threads[n]);
+            }
+        }
+
+        t = profile_begin(&prof);
+        if (fetch_programs(&context, loaders, traces)) {
+            return 1;
+        }
+        profile_end(&prof, stage_load, t);
+
+        for (int n = 0; analyses && n < num_threads; n++) {
+            if (dataflow_update(analyses[n], context.threads[n].program)) {
+                puts("analysis failed");
+                return 1;
+            }
+        }
+
+        if (memo) {
+            t = profile_begin(&prof);
+            bool replayed = memo_begin(memo, &context);
+            profile_end(&prof, stage_memo, t);
+            if (replayed) {
+                continue;
+            }
+        }
+
+        t = profile_begin(&prof);
+        retire(&context);
+        profile_end(&prof, stage_retire, t);
+
+        t = profile_begin(&prof);
+        issue(&context, reg_names);
+        profile_end(&prof, stage_issue, t);
+
+        t = profile_begin(&prof);
         execute(&context);
+        profile_end(&prof, stage_execute, t);
+
+        t = profile_begin(&prof);
         writeback(&context);
+        profile_end(&prof, stage_writeback, t);
 
-        print_state(&context, reg_contents);
-        puts("(c)ontinue, (a)bort");
-        scanf(" %c", &input);
-        switch(input) {
-            case 'c' :
-                break;
-            case 'a':
-                return 0;
+        if (memo) {
+            t = profile_begin(&prof);
+            memo_end(memo, &context);
+            profile_end(&prof, stage_memo, t);
         }
-        system("clear");    // UNIX
-        //system("cls");    // DOS
-    }
-}
-
 
-void print_state(struct state* s, char* reg_names[]) {
-    print_banner();
-    printf("Cycle : %d \n", s->cycle);
-    print_scoreboard(s->program);
-    print_stations(s->stations);
-    print_registers(reg_names, s->regfile_size);
-}
+        if (history && history_record(history, &context)) {
+            puts("history recording failed");
+            return 1;
+        }
 
+        if (batch || !(context.complete || step_done(&step, &context, history))) {
+            continue;
+        }
 
-int load_program(const char* filename, struct ilist* prog) {
-    char buffer[20];
-    char* line; 
+        if (context.complete) {
+            render_state(display, &context, NULL);
+            continue;
+        }
+        const char* prompt = PROMPT;
+        do {
+            render_state(display, &context, prompt);
+            opt = read_command(&step, &context);
+            if (opt < 0) {
+                return 0;
+            }
+            prompt = opt ? "invalid command, " PROMPT : PROMPT;
+        } while (opt || travel(&step, &context, history));
+    }
 
-    FILE *source = fopen(filename, "rt");
-    if (!source) {
-        return -1;
+    if (exporter && (export_retired(exporter, &context) || close_exporter(exporter))) {
+        printf("could not write to %s\n", export_file);
+        return 1;
     }
 
-    while (fgets(buffer, sizeof(buffer), source)) {
-        line = strtok(buffer, "\n");        // remove trailing newline
-        int result = add_inst(prog, line);
-        if (!result) {
-            //inst_details(&prog->data[prog->occupied-1]);
-        } else {
-            printf ("Error!!, code %d\n", result);
-            return -1;
+    print_summary(stdout, &context, traces);
+    if (cached) {
+        printf("Result from the cache, key %016" PRIx64 "\n", key);
+    } else if (cache_dir && result_store(cache_dir, key, &context)) {
+        printf("could not write the result to %s\n", cache_dir);
+    }
+    if (memo) {
+        memo_report(memo);
+    }
+    for (int n = 0; analyses && n < num_threads; n++) {
+        if (num_threads > 1) {
+            printf("\nThread %d (%s)", n, traces[n]);
         }
+        // programs of a cached result were not analyzed while simulating
+        if (dataflow_update(analyses[n], context.threads[n].program)) {
+            puts("analysis failed");
+            return 1;
+        }
+        dataflow_report(analyses[n], &context.threads[n]);
     }
+    for (int n = 0; n < num_threads; n++) {
+        if (!loaders[n].running) {
+            prof.decode_time += loaders[n].decode_time;
+        }
+    }
+    profile_report(&prof, &context);
     return 0;
 }
 
 
-void print_banner() {
-    puts("***********************************************************************");
-    puts("*  ELE749 Out-of-order execution demo using Tomasulo's algorithm      *");
-    puts("***********************************************************************");
-    puts("");
+void usage(const char* prog) {
+    printf("usage : %s [options] [trace ...]\n", prog);
+    puts("  each trace runs on its own hardware thread (default prog1.txt)");
+    puts("  -b, --batch          run to completion without displaying each cycle");
+    puts("  -p, --policy POLICY  SMT issue policy : rr (default) or icount");
+    puts("  -m, --machine FILE   machine description (see machine.txt)");
+    puts("  -w, --width N        instructions issued per cycle (default 1)");
+    puts("      --memo[=N]       replay the timing of repeated blocks of N instructions,");
+    puts("                       N >= 16 (default 32). Larger blocks cost less per");
+    puts("                       instruction but must repeat whole. Batch, single thread");
+    puts("      --memo-verify    simulate memoized blocks and check the recorded timing");
+    puts("  -a, --analyze        report the critical path and what bounds the cycle count");
+    puts("      --cache[=DIR]    reuse results of identical batch runs (default ~/.cache/tomasulo)");
+    puts("      --serve[=PATH]   serve jobs on a Unix socket (default " SERVER_SOCKET ")");
+    puts("      --export FILE    write the timeline of every instruction, JSON Lines if FILE");
+    puts("                       ends with .jsonl or .json, CSV otherwise (not with --serve)");
+    puts("      --monte-carlo[=N] simulate N replicas with the latency variations of the");
+    puts("                       machine (default 200) and report their cycles");
+    puts("      --seed N         seed of the Monte Carlo replicas (default 1)");
+    puts("  -j, --jobs N         jobs simulated at the same time by the server or replicas");
+    puts("  -P, --profile        report host time spent in each simulator stage");
+    puts("  -h, --help           display this message");
+}
+
+
+bool step_done(struct stepping* step, struct state* s, struct history* h) {
+    if (step->watch_station >= 0) {
+        return history_find_busy(h, step->watch_station, s->cycle - 1) == s->cycle;
+    }
+    if (step->watch_thread >= 0) {
+        struct thread* t = &s->threads[step->watch_thread];
+        return t->program->data[step->watch_inst].retired != 0;
+    }
+    return s->cycle >= step->until_cycle;
 }
 
 
-void print_scoreboard(struct ilist* program) {
-    puts("|---------------------------------------------------------------------|");
-    puts("| Instruction         | Issue     | Execute   | Writeback | Retired   |");
-    puts("|---------------------------------------------------------------------|");
-    for (size_t i = 0; i < program->occupied; i++) {
-        print_inst(&program->data[i]);
+bool travel(struct stepping* step, struct state* s, struct history* h) {
+    // reach the target of a command from the history if it was already
+    // simulated, otherwise bring back the most recent cycle to simulate on.
+    // return true if the target was reached
+    long target = 0;
+
+    if (step->watch_station >= 0) {
+        target = history_find_busy(h, step->watch_station, s->cycle);
+    } else if (step->watch_thread >= 0) {
+        target = history_retired(h, step->watch_thread, step->watch_inst);
+    } else if (step->until_cycle <= h->frontier) {
+        target = step->until_cycle;
     }
-    puts("|---------------------------------------------------------------------|");
-    puts("");
+
+    if (target) {
+        history_seek(h, s, target);
+        return true;
+    }
+    if (s->cycle != h->frontier) {
+        history_seek(h, s, h->frontier);
+    }
+    return false;
 }
 
 
-void print_stations(struct slist* stations) {
-    puts("|---------------------------------------------------------------------|");
-    puts("| Reservation stations                                                |");
-    puts("|---------------------------------------------------------------------|");
-    puts("| Name     |  Busy  |    Op   |   Vj    |    Vk   |    Qj   |    Qk   |");
-    puts("|---------------------------------------------------------------------|");
-    for (size_t i = 0; i < stations->occupied; i++) {
-        print_station(&stations->data[i]);
+int read_command(struct stepping* step, struct state* s) {
+    char line[64];
+    char name[16];
+    char cmd = 'c';
+    long arg = 1;
+    long thread = 0;
+
+    if (!fgets(line, sizeof(line), stdin)) {
+        return -1;
     }
-    puts("|---------------------------------------------------------------------|");
-    puts("");
+    int n = sscanf(line, " %c %ld %ld", &cmd, &arg, &thread);
+
+    step->watch_thread = -1;
+    step->watch_station = -1;
+    switch (cmd) {
+        case 'c':
+            if (arg < 1) {
+                return 1;
+            }
+            step->until_cycle = s->cycle + arg;
+            return 0;
+        case 'b':
+            if (arg < 1 || arg >= s->cycle) {
+                return 1;
+            }
+            step->until_cycle = s->cycle - arg;
+            return 0;
+        case 'g':
+            if (n < 2 || arg < 1 || arg == s->cycle) {
+                return 1;
+            }
+            step->until_cycle = arg;
+            return 0;
+        case 's':
+            if (sscanf(line, " %c %15s", &cmd, name) < 2) {
+                return 1;
+            }
+            for (size_t i = 0; i < s->stations->occupied; i++) {
+                if (!strcmp(name, s->stations->data[i].name)) {
+                    step->watch_station = i;
+                    return 0;
+                }
+            }
+            return 1;
+        case 'r':
+            if (n < 2 || thread < 0 || thread >= s->num_threads ||
+                    arg < 1 || (size_t) arg > s->threads[thread].program->occupied) {
+                return 1;
+            }
+            if (s->threads[thread].program->data[arg - 1].retired) {
+                // already retired, behave as a single step
+                step->until_cycle = s->cycle + 1;
+                return 0;
+            }
+            step->watch_thread = thread;
+            step->watch_inst = arg - 1;
+            return 0;
+        case 'a':
+            return -1;
+    }
+    return 1;
 }
 
 
-void print_registers(char* reg_names[], size_t num) {
-    puts("|-----------------------------------------------------------------------|");
-    puts("| Register wait queues (Qi)                                             |");
-    puts("|-----------------------------------------------------------------------|");
-    puts("|   F0   |   F2   |   F4   |   F6   |   F8   |  F10   |  F12   |  F14   |");
-    for (size_t i = 0; i < num; i++) {
-        printf("|%7s ", reg_names[i]);
+int fetch_programs(struct state* s, struct loader* loaders, char* traces[]) {
+    for (int n = 0; n < s->num_threads; n++) {
+        int result = loader_fetch(&loaders[n], s, &s->threads[n]);
+        if (result == -2) {
+            printf("%s uses more than %d registers or %d vector registers\n",
+                traces[n], s->regfile_size, s->vregfile_size);
+            return result;
+        } else if (result == -1) {
+            puts("list creation failed");
+            return result;
+        } else if (result) {
+            printf("%s, line %ld : cannot decode instruction (code %d)\n",
+                traces[n], loaders[n].line, result);
+            return result;
+        }
     }
-    puts("|");
-    puts("|-----------------------------------------------------------------------|");
+    return 0;
 }
@@ -0,0 +1,342 @@
+/****** memo.c **************************************************************
+*   Description
+*       Timing memoization of repeated instruction sequences for Tomasulo's
+*       algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "memo.h"
+#include "instruction.h"
+#include "station.h"
+#include "registers.h"
+
+#define NUM_BUCKETS     (1 << 16)
+#define MAX_ENTRIES     (1 << 20)
+
+// a field that was not modified during a block
+#define UNCHANGED       -1
+
+static void _push(struct memo* m, int value);
+static void _encode_key(struct memo* m, struct state* s);
+static void _encode_stations(struct memo* m, struct state* s, size_t base);
+static void _encode_outcome(struct memo* m, struct state* s);
+static void _apply_outcome(struct memo* m, struct state* s, int* outcome);
+static uint64_t _hash(int* data, size_t length);
+static struct memo_entry* _lookup(struct memo* m, uint64_t hash);
+static int* _copy(int* data, size_t length);
+
+
+struct memo* create_memo(int block_size, bool verify, char* reg_names[]) {
+    struct memo* m = calloc(1, sizeof(struct memo));
+    if (m == NULL) {
+        return NULL;
+    }
+
+    m->num_buckets = NUM_BUCKETS;
+    m->buckets = calloc(m->num_buckets, sizeof(struct memo_entry*));
+    if (m->buckets == NULL) {
+        return NULL;
+    }
+    m->block_size = block_size;
+    m->verify = verify;
+    m->reg_names = reg_names;
+    return m;
+}
+
+
+bool memo_begin(struct memo* m, struct state* s) {
+    if (m->recording || s->num_threads != 1) {
+        return false;
+    }
+
+    // the key covers the block and the instructions that may issue in the
+    // same cycle as its last one
+    struct thread* t = &s->threads[0];
+    if (t->next + m->block_size + s->issue_width > t->program->occupied) {
+        return false;
+    }
+
+    _encode_key(m, s);
+    uint64_t hash = _hash(m->key, m->key_length);
+    struct memo_entry* e = _lookup(m, hash);
+    m->blocks++;
+
+    if (e && !m->verify) {
+        m->hits++;
+        m->cycles_replayed += e->outcome[0];
+        _apply_outcome(m, s, e->outcome);
+        return true;
+    }
+
+    // simulate the block, then record or check its outcome
+    m->recording = true;
+    m->expected = e;
+    m->start_cycle = s->cycle;
+    m->start_head = t->head;
+    m->start_retired = t->retired;
+    m->end_next = t->next + m->block_size;
+    m->start_hash = hash;
+    if (!e) {
+        m->start_key = _copy(m->key, m->key_length);
+        m->start_key_length = m->key_length;
+    }
+    return false;
+}
+
+
+void memo_end(struct memo* m, struct state* s) {
+    if (!m->recording || s->threads[0].next < m->end_next) {
+        return;
+    }
+    m->recording = false;
+
+    // the key is no longer needed, the scratch buffer now holds the outcome
+    _encode_outcome(m, s);
+
+    if (m->expected) {
+        m->hits++;
+        if (m->expected->outcome_length != m->key_length ||
+                memcmp(m->expected->outcome, m->key, m->key_length * sizeof(int))) {
+            if (!m->mismatches) {
+                printf("memo : outcome mismatch for the block starting at cycle %ld\n",
+                       m->start_cycle);
+            }
+            m->mismatches++;
+        }
+        m->expected = NULL;
+        return;
+    }
+
+    if (!m->start_key || m->entries == MAX_ENTRIES) {
+        free(m->start_key);
+        m->start_key = NULL;
+        return;
+    }
+
+    struct memo_entry* e = malloc(sizeof(struct memo_entry));
+    int* outcome = _copy(m->key, m->key_length);
+    if (!e || !outcome) {
+        free(e);
+        free(outcome);
+        free(m->start_key);
+        m->start_key = NULL;
+        return;
+    }
+    e->hash = m->start_hash;
+    e->key = m->start_key;
+    e->key_length = m->start_key_length;
+    e->outcome = outcome;
+    e->outcome_length = m->key_length;
+
+    size_t b = e->hash & (m->num_buckets - 1);
+    e->next = m->buckets[b];
+    m->buckets[b] = e;
+    m->entries++;
+    m->start_key = NULL;
+}
+
+
+void memo_report(struct memo* m) {
+    puts("");
+    printf("Memoized blocks : %ld of %ld (%.1f%%), %ld cycles replayed, %zu entries\n",
+        m->hits, m->blocks, m->blocks ? 100.0 * m->hits / m->blocks : 0.0,
+        m->cycles_replayed, m->entries);
+    if (m->verify) {
+        printf("Verified blocks : %ld, mismatches : %ld\n", m->hits, m->mismatches);
+    }
+}
+
+
+static void _encode_key(struct memo* m, struct state* s) {
+    // everything that influences the cycles to come, relative to the
+    // current cycle and to the oldest in-flight instruction.
+    // at the start of a cycle, timestamps only matter by being set or not
+    struct thread* t = &s->threads[0];
+    m->key_length = 0;
+
+    _push(m, t->next - t->head);
+    for (size_t i = t->head; i < t->next; i++) {
+        struct instruction* inst = &t->program->data[i];
+        _push(m, inst->op);
+        _push(m, inst->rd);
+        _push(m, inst->rs1);
+        _push(m, inst->rs2);
+        _push(m, (inst->execute != 0) | (inst->writeback != 0) << 1
+                | (inst->retired != 0) << 2);
+        _push(m, inst->remaining);
+    }
+
+    size_t end = t->next + m->block_size + s->issue_width - 1;
+    for (size_t i = t->next; i < end; i++) {
+        struct instruction* inst = &t->program->data[i];
+        _push(m, inst->op);
+        _push(m, inst->rd);
+        _push(m, inst->rs1);
+        _push(m, inst->rs2);
+    }
+
+    _encode_stations(m, s, t->head);
+}
+
+
+static void _encode_stations(struct memo* m, struct state* s, size_t base) {
+    struct thread* t = &s->threads[0];
+
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        struct station* st = &s->stations->data[i];
+        _push(m, st->busy);
+        _push(m, st->busy ? (int) (st->op - &t->program->data[base]) : UNCHANGED);
+        _push(m, encode_operand(s, m->reg_names, st->vj));
+        _push(m, encode_operand(s, m->reg_names, st->vk));
+        _push(m, st->qj);
+        _push(m, st->qk);
+    }
+    for (int i = 0; i < NUM_REGS(s); i++) {
+        _push(m, t->reg_contents[i]);
+    }
+}
+
+
+static void _encode_outcome(struct memo* m, struct state* s) {
+    // layout :
+    //  cycles, head, next, in_flight, retired, last_retire
+    //  per instruction from the starting head : issue, execute, writeback,
+    //      retired, remaining, station
+    //  stations and register Qs as in the key
+    // cycles and instructions relative to the start of the block
+
+    struct thread* t = &s->threads[0];
+    long c0 = m->start_cycle;
+    m->key_length = 0;
+
+    _push(m, s->cycle - c0);
+    _push(m, t->head - m->start_head);
+    _push(m, t->next - m->start_head);
+    _push(m, t->in_flight);
+    _push(m, t->retired - m->start_retired);
+    _push(m, (t->last_retire >= c0) ? t->last_retire - c0 : UNCHANGED);
+
+    for (size_t i = m->start_head; i < t->next; i++) {
+        struct instruction* inst = &t->program->data[i];
+        _push(m, (inst->issue >= c0) ? inst->issue - c0 : UNCHANGED);
+        _push(m, (inst->execute >= c0) ? inst->execute - c0 : UNCHANGED);
+        _push(m, (inst->writeback >= c0) ? inst->writeback - c0 : UNCHANGED);
+        _push(m, (inst->retired >= c0) ? inst->retired - c0 : UNCHANGED);
+        _push(m, inst->remaining);
+        _push(m, inst->station);
+    }
+
+    _encode_stations(m, s, m->start_head);
+}
+
+
+static void _apply_outcome(struct memo* m, struct state* s, int* outcome) {
+    struct thread* t = &s->threads[0];
+    size_t base = t->head;
+    long c0 = s->cycle;
+    int* p = outcome;
+
+    s->cycle = c0 + *p++;
+    t->head = base + *p++;
+    t->next = base + *p++;
+    t->in_flight = *p++;
+    t->retired += *p++;
+    if (*p != UNCHANGED) {
+        t->last_retire = c0 + *p;
+    }
+    p++;
+
+    for (size_t i = base; i < t->next; i++) {
+        struct instruction* inst = &t->program->data[i];
+        long* fields[] = {&inst->issue, &inst->execute, &inst->writeback,
+                          &inst->retired};
+        for (int f = 0; f < 4; f++, p++) {
+            if (*p != UNCHANGED) {
+                *fields[f] = c0 + *p;
+            }
+        }
+        inst->remaining = *p++;
+        inst->station = *p++;
+        // latencies are not drawn when memoizing, see memo.h
+        inst->latency = s->latency[inst->op];
+    }
+
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        struct station* st = &s->stations->data[i];
+        st->busy = *p++;
+        if (st->busy) {
+            st->op = &t->program->data[base + *p];
+            st->thread = 0;
+        }
+        p++;
+        st->vj = decode_operand(s, m->reg_names, *p++, NULL);
+        st->vk = decode_operand(s, m->reg_names, *p++, NULL);
+        st->qj = *p++;
+        st->qk = *p++;
+    }
+    for (int i = 0; i < NUM_REGS(s); i++) {
+        t->reg_contents[i] = *p++;
+    }
+}
+
+
+static struct memo_entry* _lookup(struct memo* m, uint64_t hash) {
+    struct memo_entry* e = m->buckets[hash & (m->num_buckets - 1)];
+    for (; e != NULL; e = e->next) {
+        if (e->hash == hash && e->key_length == m->key_length
+                && !memcmp(e->key, m->key, m->key_length * sizeof(int))) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+static uint64_t _hash(int* data, size_t length) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < length * sizeof(int); i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+
+static void _push(struct memo* m, int value) {
+    if (m->key_length == m->key_size) {
+        size_t new_size = m->key_size ? m->key_size << 1 : 256;
+        int* newkey = realloc(m->key, new_size * sizeof(int));
+        if (newkey == NULL) {
+            // realloc failed, the value is dropped and the key will not
+            // match anything recorded
+            return;
+        }
+        m->key = newkey;
+        m->key_size = new_size;
+    }
+    m->key[m->key_length++] = value;
+}
+
+
+static int* _copy(int* data, size_t length) {
+    int* copy = malloc(length * sizeof(int));
+    if (copy) {
+        memcpy(copy, data, length * sizeof(int));
+    }
+    return copy;
+}
@@ -0,0 +1,156 @@
+/****** memo.h **************************************************************
+*   Description
+*       Timing memoization of repeated instruction sequences for Tomasulo's
+*       algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "tomasulo.h"
+
+// The trace is cut in blocks of block_size instructions, a block spanning
+// the cycles from the one where its first instruction may issue to the one
+// where its last instruction issues. The engine is deterministic, so the
+// state at the end of a block only depends on the state at its start and
+// on the instructions of the block (later instructions cannot issue
+// before it ends). Both are encoded relative to the starting cycle and
+// oldest in-flight instruction : when an equivalent start is met again,
+// the recorded end state is applied instead of simulating the block.
+//
+// Only single thread simulations are memoized : other threads would
+// compete for stations in ways the key does not capture, so memo_begin
+// never starts a block when the state has more than one thread and main
+// ignores --memo for SMT runs. Latencies must be those of the machine, not
+// drawn (see montecarlo.h).
+//
+// Encoding the key and outcome costs about as much as simulating a dozen
+// instructions, whatever the block size : small blocks are slower than no
+// memoization, main requires at least MEMO_MIN_BLOCK (16) instructions.
+
+struct memo_entry {
+    uint64_t hash;
+    int* key;
+    size_t key_length;
+    int* outcome;               // end state, see _encode_outcome
+    size_t outcome_length;
+    struct memo_entry* next;    // same bucket
+};
+
+struct memo {
+    int block_size;
+    bool verify;                // simulate hits and compare instead of replay
+    char** reg_names;
+
+    struct memo_entry** buckets;
+    size_t num_buckets;
+    size_t entries;
+
+    // block being simulated
+    bool recording;
+    long start_cycle;
+    size_t start_head;
+    long start_retired;
+    size_t end_next;
+    uint64_t start_hash;
+    int* start_key;                 // NULL if the block is already known
+    size_t start_key_length;
+    struct memo_entry* expected;    // verify mode : the recorded outcome
+
+    // scratch buffers, reused for every block
+    int* key;
+    size_t key_length;
+    size_t key_size;
+
+    // statistics
+    long blocks;
+    long hits;
+    long cycles_replayed;
+    long mismatches;
+};
+
+
+/****** create_memo *********************************************************
+*   Create an empty memoization table
+*
+*   Parameters :
+*       int block_size          : number of instructions per block
+*       bool verify             : simulate every hit and compare its outcome
+*                                 with the recorded one instead of replaying
+*       char *reg_names[]       : names of the register Qs, as given to issue
+*
+*   Return : pointer to the newly allocated memo if successful
+*            NULL if memory allocation fails
+*
+*   Side effects :
+*           memory for the table is allocated
+*****************************************************************************/
+struct memo* create_memo(int block_size, bool verify, char* reg_names[]);
+
+
+/****** memo_begin **********************************************************
+*   Called at the start of every cycle, before retire. When no block is
+*   in progress, a new one starts here : if its starting state was seen
+*   before, the recorded outcome is applied.
+*
+*   Parameters :
+*       struct memo* m          : memoization table
+*       struct state* s         : current simulation context
+*
+*   Return : true if a block was replayed, s->cycle is then the last cycle
+*            of the block and the stages must not run for it
+*            false if the cycle must be simulated
+*
+*   Side effects :
+*           instructions, stations, register Qs and the cycle count may be
+*           modified
+*****************************************************************************/
+bool memo_begin(struct memo* m, struct state* s);
+
+
+/****** memo_end ************************************************************
+*   Called at the end of every simulated cycle, after writeback. When the
+*   block in progress is complete, its outcome is recorded, or checked
+*   against the recorded one in verify mode.
+*
+*   Parameters :
+*       struct memo* m          : memoization table
+*       struct state* s         : current simulation context
+*
+*   Return : none
+*
+*   Side effects :
+*           memory for a new entry may be allocated
+*****************************************************************************/
+void memo_end(struct memo* m, struct state* s);
+
+
+/****** memo_report *********************************************************
+*   Display hit rate, replayed cycles and, in verify mode, mismatches
+*
+*   Parameters :
+*       struct memo* m          : memoization table
+*
+*   Return : none
+*
+*   Side effects :
+*           the report is sent to the terminal
+*****************************************************************************/
+void memo_report(struct memo* m);
+
+#endif
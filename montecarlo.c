@@ -0,0 +1,331 @@
+/****** montecarlo.c ********************************************************
+*   Description
+*       Monte Carlo runs with varying latencies for Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "montecarlo.h"
+#include "instruction.h"
+#include "station.h"
+#include "loader.h"
+
+#define GOLDEN_GAMMA    0x9e3779b97f4a7c15ull
+#define TWO_PI          6.283185307179586
+
+// replicas shared by the workers
+struct replicas {
+    struct machine* machine;
+    struct ilist** programs;        // decoded traces, never modified
+    int num_threads;
+    enum fetch_policy policy;
+    char** reg_names;
+    uint64_t seed;
+    int count;
+    atomic_int next;                // next replica to simulate
+    atomic_bool failed;
+    long* cycles;                   // total cycles of each replica
+};
+
+static void* _work(void* arg);
+static int _init_state(struct replicas* r, struct state* s);
+static int _reset_state(struct replicas* r, struct state* s);
+static void _free_state(struct state* s);
+static void _report(struct replicas* r, long fixed_cycles);
+static int _compare(const void* a, const void* b);
+static double _uniform(uint64_t* rng);
+static uint64_t _next(uint64_t* rng);
+static uint64_t _scramble(uint64_t x);
+
+
+int draw_latency(const struct distribution* d, int latency, uint64_t* rng) {
+    double cycles;
+
+    switch (d->kind) {
+        case uniform: {
+            // every whole number of cycles from a to b, equally likely
+            double low = ceil(d->a);
+            cycles = floor(low + _uniform(rng) * (floor(d->b) - low + 1));
+            break;
+        }
+        case normal: {
+            // Box-Muller, 1 - u is never 0
+            double u = _uniform(rng);
+            double v = _uniform(rng);
+            cycles = round(d->a + d->b * sqrt(-2 * log(1 - u)) * cos(TWO_PI * v));
+            break;
+        }
+        case exponential:
+            cycles = round(d->a - log(1 - _uniform(rng)) * (d->b - d->a));
+            break;
+        default:
+            return latency;
+    }
+    return (cycles < 1) ? 1 : (int) cycles;
+}
+
+
+int run_monte_carlo(struct machine* m, char* traces[], int num_threads,
+                    enum fetch_policy policy, int replicas, uint64_t seed,
+                    int workers, char* reg_names[]) {
+    struct replicas r = {
+        .machine = m,
+        .num_threads = num_threads,
+        .policy = policy,
+        .seed = seed,
+        .count = replicas,
+        .reg_names = reg_names
+    };
+    atomic_init(&r.next, 0);
+    atomic_init(&r.failed, false);
+
+    // every trace is decoded once, before any replica starts
+    r.programs = calloc(num_threads, sizeof(struct ilist*));
+    r.cycles = malloc(replicas * sizeof(long));
+    if (!r.programs || !r.cycles) {
+        puts("replica creation failed");
+        return 1;
+    }
+    for (int n = 0; n < num_threads; n++) {
+        long line = 0;
+        r.programs[n] = create_inst_list(64);
+        if (!r.programs[n]) {
+            puts("list creation failed");
+            return 1;
+        }
+        int result = load_trace(traces[n], m->regfile_size, r.programs[n], &line);
+        if (result == -1) {
+            printf("could not load %s\n", traces[n]);
+            return 1;
+        } else if (result) {
+            printf("%s, line %ld : cannot decode instruction (code %d)\n",
+                traces[n], line, result);
+            return 1;
+        }
+    }
+
+    // the machine latencies first, this also checks the registers
+    struct state s;
+    if (_init_state(&r, &s)) {
+        puts("replica creation failed");
+        return 1;
+    }
+    int result = _reset_state(&r, &s);
+    if (result == -2) {
+        printf("traces use more than %d registers or %d vector registers\n",
+            s.regfile_size, s.vregfile_size);
+        return 1;
+    } else if (result) {
+        puts("replica creation failed");
+        return 1;
+    }
+    s.variation = NULL;
+    simulate(&s, r.reg_names);
+    long fixed_cycles = s.cycle - 1;
+    _free_state(&s);
+
+    // the calling thread is one of the workers
+    if (workers > replicas) {
+        workers = replicas;
+    }
+    pthread_t* threads = malloc(workers * sizeof(pthread_t));
+    int started = 0;
+    while (threads && started < workers - 1 &&
+            !pthread_create(&threads[started], NULL, _work, &r)) {
+        started++;
+    }
+    _work(&r);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    if (atomic_load(&r.failed)) {
+        puts("replica creation failed");
+        return 1;
+    }
+    printf("\nMonte Carlo : %d replicas, seed %llu, %d threads\n", replicas,
+        (unsigned long long) seed, started + 1);
+    _report(&r, fixed_cycles);
+    return 0;
+}
+
+
+static void* _work(void* arg) {
+    // simulate replicas until there are none left, on a state allocated
+    // once per worker
+    struct replicas* r = arg;
+    struct state s;
+    int k;
+
+    if (_init_state(r, &s)) {
+        atomic_store(&r->failed, true);
+        return NULL;
+    }
+    while ((k = atomic_fetch_add(&r->next, 1)) < r->count) {
+        if (_reset_state(r, &s)) {
+            atomic_store(&r->failed, true);
+            break;
+        }
+        s.rng = _scramble(r->seed + _scramble(k));
+        simulate(&s, r->reg_names);
+        r->cycles[k] = s.cycle - 1;
+    }
+    _free_state(&s);
+    return NULL;
+}
+
+
+static int _init_state(struct replicas* r, struct state* s) {
+    struct machine* m = r->machine;
+
+    // this struct initialization method requires C99
+    *s = (struct state){0};
+    s->issue_width = m->issue_width;
+    s->regfile_size = m->regfile_size;
+    s->vregfile_size = m->vregfile_size;
+    s->vector_cycles = (m->vector_length + m->lanes - 1) / m->lanes;
+    s->latency = m->latency;
+    s->variation = m->variation;
+    s->policy = r->policy;
+    s->num_threads = r->num_threads;
+    s->threads = calloc(s->num_threads, sizeof(struct thread));
+    s->stations = create_station_list(10);
+    if (!s->threads || !s->stations || build_stations(m, s->stations)) {
+        return -1;
+    }
+
+    // copies of the programs, the texts stay shared
+    for (int n = 0; n < s->num_threads; n++) {
+        size_t size = r->programs[n]->occupied;
+        s->threads[n].program = create_inst_list(size ? size : 1);
+        if (!s->threads[n].program) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+
+static int _reset_state(struct replicas* r, struct state* s) {
+    // back to the first cycle, as before any replica
+    for (int n = 0; n < s->num_threads; n++) {
+        struct ilist* shared = r->programs[n];
+        struct ilist* program = s->threads[n].program;
+        memcpy(program->data, shared->data, shared->occupied * sizeof(struct instruction));
+        program->occupied = shared->occupied;
+        program->complete = true;
+
+        free(s->threads[n].reg_contents);
+        int result = init_thread(&s->threads[n], program, s);
+        if (result) {
+            return result;
+        }
+    }
+
+    // a complete simulation leaves the stations free, but not necessarily
+    // one that failed
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        struct station* st = &s->stations->data[i];
+        st->busy = false;
+        st->vj = st->vk = NULL;
+        st->qj = st->qk = 0;
+    }
+    s->rr_next = 0;
+    s->complete = false;
+    return 0;
+}
+
+
+static void _free_state(struct state* s) {
+    for (int n = 0; s->threads && n < s->num_threads; n++) {
+        if (s->threads[n].program) {
+            free(s->threads[n].program->data);
+            free(s->threads[n].program);
+        }
+        free(s->threads[n].reg_contents);
+    }
+    free(s->threads);
+    if (s->stations) {
+        for (size_t i = 0; i < s->stations->occupied; i++) {
+            free(s->stations->data[i].name);
+        }
+        free(s->stations->data);
+        free(s->stations);
+    }
+}
+
+
+static void _report(struct replicas* r, long fixed_cycles) {
+    int n = r->count;
+    double sum = 0;
+    double squares = 0;
+
+    qsort(r->cycles, n, sizeof(long), _compare);
+    for (int k = 0; k < n; k++) {
+        sum += r->cycles[k];
+    }
+    double mean = sum / n;
+    for (int k = 0; k < n; k++) {
+        squares += (r->cycles[k] - mean) * (r->cycles[k] - mean);
+    }
+
+    // nearest rank percentiles
+    int ranks[] = {50, 90, 99};
+    long p[3];
+    for (int i = 0; i < 3; i++) {
+        int index = (int) ceil(ranks[i] / 100.0 * n) - 1;
+        p[i] = r->cycles[(index < 0) ? 0 : index];
+    }
+
+    printf("Machine latencies : %ld cycles\n", fixed_cycles);
+    printf("Cycles : mean %.1f, deviation %.1f\n", mean,
+        (n > 1) ? sqrt(squares / (n - 1)) : 0.0);
+    printf("  min %ld, p50 %ld, p90 %ld, p99 %ld, max %ld\n", r->cycles[0],
+        p[0], p[1], p[2], r->cycles[n - 1]);
+}
+
+
+static int _compare(const void* a, const void* b) {
+    long x = *(const long*) a;
+    long y = *(const long*) b;
+    return (x > y) - (x < y);
+}
+
+
+static double _uniform(uint64_t* rng) {
+    // [0, 1) with the 53 bits of a double
+    return (_next(rng) >> 11) * 0x1.0p-53;
+}
+
+
+static uint64_t _next(uint64_t* rng) {
+    // splitmix64
+    *rng += GOLDEN_GAMMA;
+    return _scramble(*rng);
+}
+
+
+static uint64_t _scramble(uint64_t x) {
+    // splitmix64 output function, also spreads the seeds of the replicas
+    // over the whole sequence
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
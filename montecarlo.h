@@ -0,0 +1,76 @@
+/****** montecarlo.h ********************************************************
+*   Description
+*       Monte Carlo runs with varying latencies for Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef MONTECARLO_H
+#define MONTECARLO_H
+
+#include <stdint.h>
+#include "machine.h"
+#include "tomasulo.h"
+
+#define MONTE_CARLO_REPLICAS    200
+
+// The same traces are simulated many times, each replica drawing the
+// latency of every instruction it issues from the variations of the
+// machine (see load_machine). Replicas run on a pool of threads and share
+// the decoded traces, each one simulating its own copy of the
+// instructions. Replica k draws from a sequence seeded by the seed and k
+// only : results do not depend on the number of threads.
+
+
+/****** draw_latency ********************************************************
+*   Draw the execution cycles of an instruction
+*
+*   Parameters :
+*       const struct distribution* d    : distribution of its opcode
+*       int latency                     : latency of the machine, returned
+*                                         as is for a constant distribution
+*       uint64_t* rng                   : random sequence
+*
+*   Return : number of cycles, at least 1
+*
+*   Side effects :
+*           the sequence advances
+*****************************************************************************/
+int draw_latency(const struct distribution* d, int latency, uint64_t* rng);
+
+
+/****** run_monte_carlo *****************************************************
+*   Simulate replicas of a set of traces and report the distribution of
+*   their total cycles, along with the cycles of the machine latencies
+*
+*   Parameters :
+*       struct machine* m       : machine description, with its variations
+*       char* traces[]          : trace of each hardware thread
+*       int num_threads         : number of traces
+*       enum fetch_policy policy: SMT issue policy
+*       int replicas            : number of simulations
+*       uint64_t seed           : seed of the random sequences
+*       int workers             : threads simulating replicas
+*       char *reg_names[]       : names of the register Qs, as given to issue
+*
+*   Return : 0 if succesfull, 1 otherwise (the error is reported)
+*
+*   Side effects :
+*           the report is sent to the terminal
+*****************************************************************************/
+int run_monte_carlo(struct machine* m, char* traces[], int num_threads,
+                    enum fetch_policy policy, int replicas, uint64_t seed,
+                    int workers, char* reg_names[]);
+
+#endif
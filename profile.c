@@ -0,0 +1,99 @@
+/****** profile.c ***********************************************************
+*   Description
+*       Self-profiling of the stages of Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "profile.h"
+
+// must be ordered the same as enum stage
+static const char* stage_names[] = {"load", "retire", "issue", "execute",
+                                    "writeback", "memo"};
+
+static double _elapsed(struct timespec* since);
+
+
+void profile_init(struct profile* p, bool enabled) {
+    // this struct initialization method requires C99
+    *p = (struct profile){0};
+    p->enabled = enabled;
+    clock_gettime(CLOCK_MONOTONIC, &p->start_time);
+    p->start_ticks = profile_ticks();
+}
+
+
+void profile_report(struct profile* p, struct state* s) {
+    if (!p->enabled) {
+        return;
+    }
+
+    // convert ticks to seconds using the wall time elapsed since init
+    double wall = _elapsed(&p->start_time);
+    uint64_t ticks = profile_ticks() - p->start_ticks;
+    double seconds_per_tick = ticks ? wall / ticks : 0.0;
+
+    double total = 0.0;
+    double simulation = 0.0;
+    for (int i = 0; i < num_stages; i++) {
+        total += p->ticks[i] * seconds_per_tick;
+        if (i != stage_load) {
+            simulation += p->ticks[i] * seconds_per_tick;
+        }
+    }
+
+    long instructions = 0;
+    for (int n = 0; n < s->num_threads; n++) {
+        instructions += s->threads[n].retired;
+    }
+    long cycles = s->cycle - 1;
+
+    puts("");
+    puts("|-------------------------------------------------------------|");
+    puts("| Stage      |    Time (s) |   Share |     Calls |    ns/call |");
+    puts("|-------------------------------------------------------------|");
+    for (int i = 0; i < num_stages; i++) {
+        double t = p->ticks[i] * seconds_per_tick;
+        printf("| %-10s | %11.6f | %6.2f%% | %9llu | %10.1f |\n", stage_names[i], t,
+            total > 0 ? 100.0 * t / total : 0.0,
+            (unsigned long long) p->calls[i],
+            p->calls[i] ? 1e9 * t / p->calls[i] : 0.0);
+    }
+    puts("|-------------------------------------------------------------|");
+    if (p->decode_time > 0) {
+        // the load stage only waits for these threads
+        printf("Decoding on loader threads             : %.6f s\n", p->decode_time);
+    }
+
+    if (simulation > 0) {
+        printf("Simulated cycles per host second       : %.0f\n", cycles / simulation);
+        printf("Retired instructions per host second   : %.0f\n", instructions / simulation);
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // ru_maxrss is in kilobytes on Linux
+        printf("Peak memory (resident)                 : %ld KiB\n", usage.ru_maxrss);
+    }
+    printf("Host time                              : %.6f s\n", wall);
+}
+
+
+static double _elapsed(struct timespec* since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) + (now.tv_nsec - since->tv_nsec) * 1e-9;
+}
@@ -0,0 +1,113 @@
+/****** profile.h ***********************************************************
+*   Description
+*       Self-profiling of the stages of Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "tomasulo.h"
+
+// host time is accumulated separately for each of these
+// must be ordered the same as stage_names in profile.c
+enum stage {stage_load, stage_retire, stage_issue, stage_execute,
+            stage_writeback, stage_memo, num_stages};
+
+struct profile {
+    bool enabled;
+    uint64_t ticks[num_stages];
+    uint64_t calls[num_stages];
+    uint64_t start_ticks;       // calibration of ticks against wall time
+    struct timespec start_time;
+    double decode_time;         // loader threads, overlapped with the stages
+};
+
+
+/****** profile_ticks *******************************************************
+*   Read the timestamp counter, or a monotonic clock in nanoseconds where
+*   no counter is available
+*****************************************************************************/
+static inline uint64_t profile_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+#endif
+}
+
+
+/****** profile_begin / profile_end *****************************************
+*   Bracket a call to a stage. Only a branch is added when profiling is
+*   disabled.
+*
+*   Usage :
+*       uint64_t t = profile_begin(&p);
+*       issue(...);
+*       profile_end(&p, stage_issue, t);
+*****************************************************************************/
+static inline uint64_t profile_begin(struct profile* p) {
+    return p->enabled ? profile_ticks() : 0;
+}
+
+static inline void profile_end(struct profile* p, enum stage st, uint64_t start) {
+    if (p->enabled) {
+        p->ticks[st] += profile_ticks() - start;
+        p->calls[st]++;
+    }
+}
+
+
+/****** profile_init ********************************************************
+*   Reset counters and record the calibration starting point
+*       
+*   Parameters : 
+*       struct profile* p       : profile to initialize
+*       bool enabled            : whether stages are timed
+*
+*   Return : none
+*
+*   Side effects : 
+*           p is modified
+*****************************************************************************/
+void profile_init(struct profile* p, bool enabled);
+
+
+/****** profile_report ******************************************************
+*   Display host time and call count per stage, simulation throughput in
+*   cycles and instructions per host second, and peak memory use. Traces
+*   decoded on loader threads are reported apart, the load stage only
+*   counts the time the simulation waits for them
+*       
+*   Parameters : 
+*       struct profile* p       : accumulated profile
+*       struct state* s         : simulation context after the run
+*
+*   Return : none
+*
+*   Side effects : 
+*           the report is sent to the terminal
+*****************************************************************************/
+void profile_report(struct profile* p, struct state* s);
+
+#endif
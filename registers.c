@@ -0,0 +1,91 @@
+/****** registers.c *********************************************************
+*   Description
+*       Names of the register Qs of Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "registers.h"
+#include "station.h"
+
+
+char** register_names(int count, int vcount) {
+    char** names = calloc(count + vcount, sizeof(char*));
+    if (!names) {
+        return NULL;
+    }
+    for (int i = 0; i < count + vcount; i++) {
+        names[i] = malloc(REG_NAME_SIZE);
+        if (!names[i]) {
+            free_register_names(names, count, vcount);
+            return NULL;
+        }
+        if (i < count) {
+            snprintf(names[i], REG_NAME_SIZE, "F%d", i << 1);
+        } else {
+            snprintf(names[i], REG_NAME_SIZE, "V%d", i - count);
+        }
+    }
+    return names;
+}
+
+
+void free_register_names(char** names, int count, int vcount) {
+    for (int i = 0; names && i < count + vcount; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+
+int encode_operand(struct state* s, char* reg_names[], const char* text) {
+    if (text == NULL || text[0] == '\0') {
+        return 0;
+    }
+    // operands always point to one of these strings, compare pointers
+    // first and only fall back to the text if that fails
+    for (int i = 0; i < NUM_REGS(s); i++) {
+        if (text == reg_names[i]) {
+            return 1 + i;
+        }
+    }
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        if (text == s->stations->data[i].name) {
+            return 1 + NUM_REGS(s) + i;
+        }
+    }
+    for (int i = 0; i < NUM_REGS(s); i++) {
+        if (!strcmp(text, reg_names[i])) {
+            return 1 + i;
+        }
+    }
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        if (!strcmp(text, s->stations->data[i].name)) {
+            return 1 + NUM_REGS(s) + i;
+        }
+    }
+    return 0;
+}
+
+
+char* decode_operand(struct state* s, char* reg_names[], int code, char* none) {
+    if (code == 0) {
+        return none;
+    }
+    if (code <= NUM_REGS(s)) {
+        return reg_names[code - 1];
+    }
+    return s->stations->data[code - 1 - NUM_REGS(s)].name;
+}
@@ -0,0 +1,93 @@
+/****** registers.h *********************************************************
+*   Description
+*       Names of the register Qs of Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef REGISTERS_H
+#define REGISTERS_H
+
+#include <stdlib.h>
+#include "tomasulo.h"
+
+// room for "F" or "V" followed by any int
+#define REG_NAME_SIZE   16
+
+
+/****** register_names ******************************************************
+*   Name the register Qs of a machine : the even floating point registers
+*   (F0, F2, ...) followed by the vector registers (V0, V1, ...)
+*       
+*   Parameters : 
+*       int count               : scalar registers of the machine
+*       int vcount              : vector registers of the machine
+*
+*   Return : array of count + vcount names if succesfull,
+*            NULL if memory allocation fails
+*
+*   Side effects : 
+*           memory for the array and each name is allocated
+*****************************************************************************/
+char** register_names(int count, int vcount);
+
+
+/****** free_register_names *************************************************
+*   Free names created by register_names
+*       
+*   Parameters : 
+*       char** names            : names to free, may be NULL
+*       int count               : scalar registers of the machine
+*       int vcount              : vector registers of the machine
+*
+*   Return : none
+*
+*   Side effects : 
+*           memory of the array and each name is freed
+*****************************************************************************/
+void free_register_names(char** names, int count, int vcount);
+
+
+/****** encode_operand ******************************************************
+*   Number the content of an operand, which holds either a register name
+*   or a station name : 1..NUM_REGS for the registers, NUM_REGS+1.. for
+*   the stations
+*       
+*   Parameters : 
+*       struct state* s         : current simulation context
+*       char* reg_names[]       : names of the register Qs, as given to issue
+*       const char* text        : content of the operand, may be NULL
+*
+*   Return : code of the operand, 0 if it is empty or unknown
+*
+*   Side effects : none
+*****************************************************************************/
+int encode_operand(struct state* s, char* reg_names[], const char* text);
+
+
+/****** decode_operand ******************************************************
+*   Find the name coded by encode_operand
+*       
+*   Parameters : 
+*       struct state* s         : current simulation context
+*       char* reg_names[]       : names of the register Qs, as given to issue
+*       int code                : code of the operand
+*       char* none              : returned for code 0
+*
+*   Return : register or station name, none for code 0
+*
+*   Side effects : none
+*****************************************************************************/
+char* decode_operand(struct state* s, char* reg_names[], int code, char* none);
+
+#endif
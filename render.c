@@ -0,0 +1,307 @@
+/****** render.c ************************************************************
+*   Description
+*       Incremental terminal renderer for the interactive mode of
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "render.h"
+#include "instruction.h"
+#include "station.h"
+#include "array.h"
+
+#define DEFAULT_ROWS    50
+#define MIN_WINDOW      3
+#define REGS_PER_ROW    8       // register Qs on a line of the table
+
+static void _line(struct frame* f, const char* fmt, ...);
+static void _out(struct render* r, const char* text, size_t length);
+static void _compose(struct render* r, struct state* s, const char* prompt);
+static void _compose_scoreboard(struct frame* f, struct thread* t, int rows);
+static void _compose_registers(struct frame* f, struct slist* stations,
+                               char prefix, int shift, int* contents, int count);
+static void _diff(struct render* r, int full);
+static int _terminal_rows(void);
+
+
+struct render* create_renderer(void) {
+    struct render* r = calloc(1, sizeof(struct render));
+    if (r == NULL) {
+        return NULL;
+    }
+    r->first = true;
+    return r;
+}
+
+
+void render_state(struct render* r, struct state* s, const char* prompt) {
+    int rows = _terminal_rows();
+    int full = r->first || rows != r->rows;
+    r->rows = rows;
+
+    _compose(r, s, prompt);
+
+    r->out_length = 0;
+    if (full) {
+        _out(r, "\033[H\033[2J", 7);
+    }
+    _diff(r, full);
+
+    // leave the cursor after the prompt, or below the frame, and erase
+    // whatever was typed at the previous prompt
+    char pos[32];
+    size_t last = r->next.num_lines;
+    int n;
+    if (prompt) {
+        n = snprintf(pos, sizeof(pos), "\033[%zu;%zuH\033[J", last,
+                     strlen(prompt) + 1);
+    } else {
+        n = snprintf(pos, sizeof(pos), "\033[%zu;1H\033[J", last + 1);
+    }
+    _out(r, pos, n);
+
+    fwrite(r->out, 1, r->out_length, stdout);
+    fflush(stdout);
+
+    // the composed frame is now on screen
+    struct frame tmp = r->shown;
+    r->shown = r->next;
+    r->next = tmp;
+    r->first = false;
+}
+
+
+static void _compose(struct render* r, struct state* s, const char* prompt) {
+    struct frame* f = &r->next;
+    int multi = s->num_threads > 1;
+    f->length = 0;
+    f->num_lines = 0;
+
+    // count the fixed lines to find how many instructions fit on screen
+    int reg_rows = (s->regfile_size + REGS_PER_ROW - 1) / REGS_PER_ROW
+                 + (s->vregfile_size + REGS_PER_ROW - 1) / REGS_PER_ROW;
+    int fixed = 5 + 1
+              + s->num_threads * (5 + multi)
+              + 7 + (int) s->stations->occupied
+              + s->num_threads * (4 + multi + 2 * reg_rows)
+              + 1 + 1;
+    int window = (r->rows - fixed) / s->num_threads;
+    if (window < MIN_WINDOW) {
+        window = MIN_WINDOW;
+    }
+
+    _line(f, "***********************************************************************");
+    _line(f, "*  ELE749 Out-of-order execution demo using Tomasulo's algorithm      *");
+    _line(f, "***********************************************************************");
+    _line(f, "");
+    _line(f, "Cycle : %ld ", s->cycle);
+
+    for (int n = 0; n < s->num_threads; n++) {
+        if (multi) {
+            _line(f, "Thread %d", n);
+        }
+        _compose_scoreboard(f, &s->threads[n], window);
+    }
+
+    _line(f, "|---------------------------------------------------------------------|");
+    _line(f, "| Reservation stations                                                |");
+    _line(f, "|---------------------------------------------------------------------|");
+    _line(f, "| Name     |  Busy  |    Op   |   Vj    |    Vk   |    Qj   |    Qk   |");
+    _line(f, "|---------------------------------------------------------------------|");
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        char text[80];
+        format_station(text, sizeof(text), s->stations, &s->stations->data[i]);
+        _line(f, "%s", text);
+    }
+    _line(f, "|---------------------------------------------------------------------|");
+    _line(f, "");
+
+    for (int n = 0; n < s->num_threads; n++) {
+        int* contents = s->threads[n].reg_contents;
+
+        if (multi) {
+            _line(f, "Thread %d", n);
+        }
+        _line(f, "|-----------------------------------------------------------------------|");
+        _line(f, "| Register wait queues (Qi)                                             |");
+        _line(f, "|-----------------------------------------------------------------------|");
+        _compose_registers(f, s->stations, 'F', 1, contents, s->regfile_size);
+        // vector register Qs follow the scalar ones
+        _compose_registers(f, s->stations, 'V', 0, contents + s->regfile_size,
+                           s->vregfile_size);
+        _line(f, "|-----------------------------------------------------------------------|");
+    }
+
+    _line(f, "%s", prompt ? prompt : "");
+}
+
+
+static void _compose_registers(struct frame* f, struct slist* stations,
+                               char prefix, int shift, int* contents, int count) {
+    // a line of names, then a line of Qs, for every REGS_PER_ROW registers
+    // so that the table keeps the width of the others. Cells are 9
+    // characters wide, unless a station name is longer
+    char text[REGS_PER_ROW * 32];
+
+    for (int first = 0; first < count; first += REGS_PER_ROW) {
+        int last = (first + REGS_PER_ROW < count) ? first + REGS_PER_ROW : count;
+        size_t len = 0;
+        for (int i = first; i < last; i++) {
+            char name[16];
+            snprintf(name, sizeof(name), "%c%d", prefix, i << shift);
+            len += snprintf(text + len, sizeof(text) - len, "|%5s   ", name);
+        }
+        _line(f, "%s|", text);
+        len = 0;
+        for (int i = first; i < last; i++) {
+            len += snprintf(text + len, sizeof(text) - len, "|%7s ",
+                            station_name(stations, contents[i]));
+        }
+        _line(f, "%s|", text);
+    }
+}
+
+
+static void _compose_scoreboard(struct frame* f, struct thread* t, int rows) {
+    // in-flight window : oldest unretired instruction up to the last issued,
+    // followed by the instructions waiting to issue if there is room
+    size_t first = t->head;
+    size_t last = t->next;
+    size_t total = t->program->occupied;
+
+    if (last - first > (size_t) rows) {
+        last = first + rows;
+    }
+    while (last < total && last - first < (size_t) rows) {
+        last++;
+    }
+    if (first == total && total > 0) {
+        // everything retired, keep the tail of the program on screen
+        first = (total > (size_t) rows) ? total - rows : 0;
+    }
+
+    _line(f, "|---------------------------------------------------------------------|");
+    _line(f, "| Instruction         | Issue     | Execute   | Writeback | Retired   |");
+    _line(f, "|---------------------------------------------------------------------|");
+    for (size_t i = first; i < last; i++) {
+        char text[80];
+        format_inst(text, sizeof(text), &t->program->data[i]);
+        _line(f, "%s", text);
+    }
+    // footer tells which part of the program is displayed
+    char label[72];
+    char dashes[72];
+    int n = snprintf(label, sizeof(label), " %zu-%zu of %zu ",
+                     (first < last) ? first + 1 : first, last, total);
+    memset(dashes, '-', sizeof(dashes));
+    dashes[(n < 69) ? 69 - n : 0] = '\0';
+    _line(f, "|%s%s|", dashes, label);
+    _line(f, "");
+}
+
+
+static void _diff(struct render* r, int full) {
+    struct frame* old = &r->shown;
+    struct frame* cur = &r->next;
+    char pos[32];
+
+    for (size_t i = 0; i < cur->num_lines; i++) {
+        const char* text = cur->text + cur->lines[i];
+        size_t len = strlen(text);
+        const char* prev = "";
+        size_t prev_len = 0;
+
+        if (!full && i < old->num_lines) {
+            prev = old->text + old->lines[i];
+            prev_len = strlen(prev);
+        }
+
+        // first and last columns that differ
+        size_t start = 0;
+        while (start < len && start < prev_len && text[start] == prev[start]) {
+            start++;
+        }
+        if (start == len && start == prev_len) {
+            continue;
+        }
+        size_t end = len;
+        if (len == prev_len) {
+            while (end > start && text[end - 1] == prev[end - 1]) {
+                end--;
+            }
+        }
+
+        int n = snprintf(pos, sizeof(pos), "\033[%zu;%zuH", i + 1, start + 1);
+        _out(r, pos, n);
+        _out(r, text + start, end - start);
+        if (prev_len > len) {
+            _out(r, "\033[K", 3);
+        }
+    }
+
+    // a shorter frame leaves old lines at the bottom
+    if (!full && old->num_lines > cur->num_lines) {
+        int n = snprintf(pos, sizeof(pos), "\033[%zu;1H\033[J",
+                         cur->num_lines + 1);
+        _out(r, pos, n);
+    }
+}
+
+
+static void _line(struct frame* f, const char* fmt, ...) {
+    va_list args;
+
+    if (grow_array(&f->lines, &f->lines_size, f->num_lines + 1, sizeof(size_t))) {
+        return;
+    }
+
+    va_start(args, fmt);
+    int n = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (grow_array(&f->text, &f->size, f->length + n + 1, 1)) {
+        return;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(f->text + f->length, n + 1, fmt, args);
+    va_end(args);
+
+    // lines are kept NUL terminated so they can be compared as strings
+    f->lines[f->num_lines++] = f->length;
+    f->length += n + 1;
+}
+
+
+static void _out(struct render* r, const char* text, size_t length) {
+    if (grow_array(&r->out, &r->out_size, r->out_length + length, 1)) {
+        return;
+    }
+    memcpy(r->out + r->out_length, text, length);
+    r->out_length += length;
+}
+
+
+static int _terminal_rows(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) {
+        return ws.ws_row;
+    }
+    return DEFAULT_ROWS;
+}
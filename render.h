@@ -0,0 +1,81 @@
+/****** render.h ************************************************************
+*   Description
+*       Incremental terminal renderer for the interactive mode of
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stdlib.h>
+#include "tomasulo.h"
+
+// a frame is composed in memory, then compared line by line with the
+// frame currently on screen. Only the changed span of each line is sent,
+// using ANSI cursor positioning, in a single write.
+struct frame {
+    char* text;             // lines, each NUL terminated
+    size_t length;
+    size_t size;
+    size_t* lines;          // offset of the start of each line
+    size_t num_lines;
+    size_t lines_size;
+};
+
+struct render {
+    struct frame shown;     // what the terminal currently displays
+    struct frame next;      // frame being composed
+    char* out;              // escape sequences and text to send
+    size_t out_length;
+    size_t out_size;
+    bool first;             // nothing drawn yet, the screen must be cleared
+    int rows;               // terminal height
+};
+
+
+/****** create_renderer *****************************************************
+*   Create a renderer for the terminal attached to stdout
+*
+*   Parameters : none
+*
+*   Return : pointer to the newly allocated renderer if successful
+*            NULL if memory allocation fails
+*
+*   Side effects :
+*           memory for the renderer and its frame buffers is allocated
+*****************************************************************************/
+struct render* create_renderer(void);
+
+
+/****** render_state ********************************************************
+*   Display the simulation state, redrawing only what changed since the
+*   previous call. Only the in-flight window of each thread (oldest
+*   unretired instruction to the last issued, plus the next ones waiting)
+*   is shown so that the frame fits the terminal.
+*
+*   Parameters :
+*       struct render* r        : renderer
+*       struct state* s 		: current simulation context
+*       const char* prompt      : text of the last line, cursor is left after
+*                                 it. NULL leaves the cursor below the frame
+*
+*   Return : none
+*
+*   Side effects :
+*           escape sequences and text are sent to the terminal
+*****************************************************************************/
+void render_state(struct render* r, struct state* s, const char* prompt);
+
+#endif
@@ -0,0 +1,194 @@
+/****** results.c ***********************************************************
+*   Description
+*       On-disk cache of simulation results, addressed by the content of
+*       the decoded traces and of the machine, for Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "results.h"
+#include "instruction.h"
+#include "station.h"
+
+#define PATH_LENGTH     4096
+
+static uint64_t _mix(uint64_t h, const void* data, size_t length);
+static uint64_t _mix_int(uint64_t h, int value);
+static int _path(char* buf, size_t size, const char* dir, uint64_t key,
+                 const char* suffix);
+
+
+uint64_t result_key(struct state* s) {
+    // FNV-1a
+    uint64_t h = 14695981039346656037ull;
+
+    h = _mix(h, TOMASULO_VERSION, sizeof(TOMASULO_VERSION));
+    h = _mix_int(h, s->issue_width);
+    h = _mix_int(h, s->regfile_size);
+    h = _mix_int(h, s->vregfile_size);
+    h = _mix_int(h, s->vector_cycles);
+    h = _mix_int(h, s->policy);
+    for (int op = 0; op < num_opcodes; op++) {
+        h = _mix_int(h, s->latency[op]);
+    }
+    // the first free station is taken, the order of the types matters
+    h = _mix_int(h, s->stations->occupied);
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        h = _mix_int(h, s->stations->data[i].type);
+    }
+
+    h = _mix_int(h, s->num_threads);
+    for (int n = 0; n < s->num_threads; n++) {
+        struct ilist* program = s->threads[n].program;
+        h = _mix_int(h, program->occupied);
+        for (size_t i = 0; i < program->occupied; i++) {
+            struct instruction* inst = &program->data[i];
+            int fields[] = {inst->op, inst->rd, inst->rs1, inst->rs2};
+            h = _mix(h, fields, sizeof(fields));
+        }
+    }
+    return h;
+}
+
+
+int result_lookup(const char* dir, uint64_t key, struct state* s) {
+    char path[PATH_LENGTH];
+    char version[64];
+    uint64_t stored;
+    long cycles;
+
+    if (_path(path, sizeof(path), dir, key, "")) {
+        return -1;
+    }
+    FILE* f = fopen(path, "rt");
+    if (!f) {
+        return -1;
+    }
+
+    // the header is checked again, against a hash collision or a file
+    // left by an older format
+    int ok = fscanf(f, "tomasulo %63s\n", version) == 1
+          && !strcmp(version, TOMASULO_VERSION)
+          && fscanf(f, "key %" SCNx64 "\n", &stored) == 1 && stored == key
+          && fscanf(f, "cycles %ld\n", &cycles) == 1;
+
+    for (int n = 0; ok && n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        int id;
+        ok = fscanf(f, "thread %d %ld %ld\n", &id, &t->retired, &t->last_retire) == 3
+          && id == n && (size_t) t->retired == t->program->occupied;
+    }
+    fclose(f);
+
+    if (!ok) {
+        for (int n = 0; n < s->num_threads; n++) {
+            s->threads[n].retired = 0;
+            s->threads[n].last_retire = 0;
+        }
+        return -1;
+    }
+    s->cycle = cycles + 1;
+    s->complete = true;
+    return 0;
+}
+
+
+int result_store(const char* dir, uint64_t key, struct state* s) {
+    char path[PATH_LENGTH];
+    char tmp[PATH_LENGTH];
+
+    // the directory and its parent (the usual ~/.cache) are created
+    char parent[PATH_LENGTH];
+    snprintf(parent, sizeof(parent), "%s", dir);
+    char* slash = strrchr(parent, '/');
+    if (slash && slash != parent) {
+        *slash = '\0';
+        mkdir(parent, 0777);
+    }
+    if (mkdir(dir, 0777) && errno != EEXIST) {
+        return -1;
+    }
+
+    // written aside then renamed, concurrent runs never see half a result
+    if (_path(path, sizeof(path), dir, key, "") ||
+            _path(tmp, sizeof(tmp), dir, key, ".XXXXXX")) {
+        return -1;
+    }
+    int fd = mkstemp(tmp);
+    FILE* f = (fd >= 0) ? fdopen(fd, "w") : NULL;
+    if (!f) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tmp);
+        }
+        return -1;
+    }
+    fprintf(f, "tomasulo %s\n", TOMASULO_VERSION);
+    fprintf(f, "key %016" PRIx64 "\n", key);
+    fprintf(f, "cycles %ld\n", s->cycle - 1);
+    for (int n = 0; n < s->num_threads; n++) {
+        fprintf(f, "thread %d %ld %ld\n", n, s->threads[n].retired,
+            s->threads[n].last_retire);
+    }
+    if (fclose(f) || rename(tmp, path)) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+
+char* result_cache_dir(void) {
+    const char* base = getenv("XDG_CACHE_HOME");
+    const char* sub = "tomasulo";
+    char path[PATH_LENGTH];
+
+    if (!base || !base[0]) {
+        base = getenv("HOME");
+        sub = ".cache/tomasulo";
+    }
+    if (!base || !base[0]) {
+        return NULL;
+    }
+    snprintf(path, sizeof(path), "%s/%s", base, sub);
+    return strdup(path);
+}
+
+
+static int _path(char* buf, size_t size, const char* dir, uint64_t key,
+                 const char* suffix) {
+    int n = snprintf(buf, size, "%s/%016" PRIx64 "%s", dir, key, suffix);
+    return (n < 0 || (size_t) n >= size) ? -1 : 0;
+}
+
+
+static uint64_t _mix(uint64_t h, const void* data, size_t length) {
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+
+static uint64_t _mix_int(uint64_t h, int value) {
+    return _mix(h, &value, sizeof(value));
+}
@@ -0,0 +1,102 @@
+/****** results.h ***********************************************************
+*   Description
+*       On-disk cache of simulation results, addressed by the content of
+*       the decoded traces and of the machine, for Tomasulo's algorithm
+*       simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef RESULTS_H
+#define RESULTS_H
+
+#include <stdint.h>
+#include "tomasulo.h"
+
+// set by the build, see CMakeLists.txt. It is part of every key : results
+// recorded by another version of the simulator are never found
+#ifndef TOMASULO_VERSION
+#define TOMASULO_VERSION "dev"
+#endif
+
+// Each result is a small text file named after its key, a hash of the
+// version, of everything in the machine that affects timing (issue width,
+// latencies, station types in order, SMT policy) and of the decoded
+// instructions of every thread. Trace names and station names are not
+// part of it : renaming a file does not cause a miss.
+
+
+/****** result_key **********************************************************
+*   Compute the key of a simulation
+*       
+*   Parameters : 
+*       struct state* s         : simulation context, before the first
+*                                 cycle, every program entirely loaded
+*
+*   Return : the key
+*
+*   Side effects : none
+*****************************************************************************/
+uint64_t result_key(struct state* s);
+
+
+/****** result_lookup *******************************************************
+*   Load the result of a simulation from the cache
+*       
+*   Parameters : 
+*       const char* dir         : cache directory
+*       uint64_t key            : key of the simulation
+*       struct state* s         : simulation context, as given to result_key
+*
+*   Return : 0 if the result was found, s is then as at the end of the
+*            simulation for print_summary, non-zero otherwise
+*
+*   Side effects : 
+*           the cycle count, the retirement statistics of the threads and
+*           s->complete are set on a hit
+*****************************************************************************/
+int result_lookup(const char* dir, uint64_t key, struct state* s);
+
+
+/****** result_store ********************************************************
+*   Record the result of a completed simulation in the cache
+*       
+*   Parameters : 
+*       const char* dir         : cache directory, created if missing
+*       uint64_t key            : key of the simulation
+*       struct state* s         : simulation context, once complete
+*
+*   Return : 0 if succesfull, -1 if the result cannot be written
+*
+*   Side effects : 
+*           a file is created in dir, replacing any previous result with
+*           the same key
+*****************************************************************************/
+int result_store(const char* dir, uint64_t key, struct state* s);
+
+
+/****** result_cache_dir ****************************************************
+*   Default cache directory : $XDG_CACHE_HOME/tomasulo, or
+*   $HOME/.cache/tomasulo
+*       
+*   Parameters : none
+*
+*   Return : the path, NULL if neither variable is set or memory
+*            allocation fails
+*
+*   Side effects : 
+*           memory for the path is allocated
+*****************************************************************************/
+char* result_cache_dir(void);
+
+#endif
@@ -0,0 +1,646 @@
+/****** server.c ************************************************************
+*   Description
+*       Simulation server accepting jobs over a Unix domain socket for
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "server.h"
+#include "station.h"
+#include "machine.h"
+#include "loader.h"
+#include "results.h"
+#include "registers.h"
+
+#define LINE_LENGTH     512
+
+static volatile sig_atomic_t stopping = 0;
+
+static void _stop(int sig);
+static void* _serve_connection(void* arg);
+static void* _work(void* arg);
+static void _run_job(struct server* srv, struct job* j);
+static int _simulate_job(struct server* srv, struct job* j, FILE* out);
+static struct cached_trace* _cache_get(struct trace_cache* c, const char* path,
+                                       int regfile_size, int* error, long* line);
+static void _cache_release(struct trace_cache* c, struct cached_trace* e);
+static void _cache_drop(struct cached_trace* e);
+static int _unlink_stale(const char* path, struct sockaddr_un* addr);
+static void _free_program(struct ilist* program, bool texts);
+static void _free_job(struct job* j);
+static void _reject(struct job* j, const char* error);
+
+// arguments of a connection thread
+struct client {
+    struct server* srv;
+    struct connection* conn;
+};
+
+
+int run_server(const char* path, int workers, const char* results) {
+    static struct server srv = {
+        .cache = {.lock = PTHREAD_MUTEX_INITIALIZER},
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .ready = PTHREAD_COND_INITIALIZER,
+        .closed = PTHREAD_COND_INITIALIZER
+    };
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        printf("socket path too long : %s\n", path);
+        return 1;
+    }
+    strcpy(addr.sun_path, path);
+    srv.results = results;
+
+    if (_unlink_stale(path, &addr)) {
+        printf("a server already listens on %s\n", path);
+        return 1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) ||
+            listen(fd, SOMAXCONN)) {
+        printf("cannot listen on %s : %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    // the stop signals are only delivered while waiting for a client,
+    // every other thread keeps them blocked. A client leaving early must
+    // not kill the server
+    struct sigaction sa = {.sa_handler = _stop};
+    sigset_t stop_signals;
+    sigset_t waiting;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, &waiting);
+    sigdelset(&waiting, SIGINT);
+    sigdelset(&waiting, SIGTERM);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    pthread_t* threads = malloc(workers * sizeof(pthread_t));
+    int started = 0;
+    while (threads && started < workers &&
+            !pthread_create(&threads[started], NULL, _work, &srv)) {
+        started++;
+    }
+    if (started < workers) {
+        puts("worker creation failed");
+        close(fd);
+        unlink(path);
+        workers = 0;
+    } else {
+        printf("serving on %s with %d workers\n", path, workers);
+        fflush(stdout);
+    }
+
+    while (workers && !stopping) {
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+        if (pselect(fd + 1, &readable, NULL, NULL, NULL, &waiting) <= 0) {
+            continue;
+        }
+        int client_fd = accept(fd, NULL, NULL);
+        if (client_fd < 0) {
+            continue;
+        }
+        struct client* c = malloc(sizeof(struct client));
+        struct connection* conn = calloc(1, sizeof(struct connection));
+        pthread_t thread;
+        if (!c || !conn) {
+            close(client_fd);
+            free(c);
+            free(conn);
+            continue;
+        }
+        conn->fd = client_fd;
+        pthread_mutex_init(&conn->lock, NULL);
+        pthread_cond_init(&conn->idle, NULL);
+        c->srv = &srv;
+        c->conn = conn;
+
+        // registered before its thread runs, so that a stop sees it
+        pthread_mutex_lock(&srv.lock);
+        conn->next = srv.connections;
+        srv.connections = conn;
+        pthread_mutex_unlock(&srv.lock);
+        if (pthread_create(&thread, NULL, _serve_connection, c)) {
+            pthread_mutex_lock(&srv.lock);
+            srv.connections = conn->next;
+            pthread_mutex_unlock(&srv.lock);
+            close(client_fd);
+            free(c);
+            free(conn);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+
+    // no more jobs are read, those already submitted are answered before
+    // the connections close and the workers leave
+    if (workers) {
+        close(fd);
+        unlink(path);
+    }
+    pthread_mutex_lock(&srv.lock);
+    for (struct connection* conn = srv.connections; conn; conn = conn->next) {
+        shutdown(conn->fd, SHUT_RD);
+    }
+    while (srv.connections) {
+        pthread_cond_wait(&srv.closed, &srv.lock);
+    }
+    srv.stopping = true;
+    pthread_cond_broadcast(&srv.ready);
+    pthread_mutex_unlock(&srv.lock);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return workers ? 0 : 1;
+}
+
+
+static void _stop(int sig) {
+    (void) sig;
+    stopping = 1;
+}
+
+
+static void* _serve_connection(void* arg) {
+    // read the jobs of a client and queue them, then wait for the workers
+    // to answer all of them before closing
+    struct client* c = arg;
+    struct server* srv = c->srv;
+    struct connection* conn = c->conn;
+    char line[LINE_LENGTH];
+    struct job* j = NULL;
+    int id = 0;
+
+    free(c);
+    FILE* in = fdopen(dup(conn->fd), "r");
+
+    while (in && fgets(line, sizeof(line), in)) {
+        char word[16];
+        char value[LINE_LENGTH];
+        char error[48];
+        int n = sscanf(line, " %15s %511[^\r\n]", word, value);
+
+        if (n < 1) {
+            continue;
+        }
+        if (!j && !(j = calloc(1, sizeof(struct job)))) {
+            break;
+        }
+
+        if (n == 1 && !strcmp(word, "run")) {
+            j->conn = conn;
+            j->id = ++id;
+            pthread_mutex_lock(&conn->lock);
+            conn->pending++;
+            pthread_mutex_unlock(&conn->lock);
+
+            pthread_mutex_lock(&srv->lock);
+            if (srv->last) {
+                srv->last->next = j;
+            } else {
+                srv->first = j;
+            }
+            srv->last = j;
+            pthread_cond_signal(&srv->ready);
+            pthread_mutex_unlock(&srv->lock);
+            j = NULL;
+        } else if (n == 2 && !strcmp(word, "trace")) {
+            if (j->num_traces < MAX_JOB_THREADS) {
+                j->traces[j->num_traces++] = strdup(value);
+            } else {
+                snprintf(error, sizeof(error), "more than %d traces",
+                         MAX_JOB_THREADS);
+                _reject(j, error);
+            }
+        } else if (n == 2 && !strcmp(word, "machine")) {
+            free(j->machine_file);
+            j->machine_file = strdup(value);
+        } else if (n == 2 && !strcmp(word, "width")) {
+            char* end;
+            long width = strtol(value, &end, 10);
+            if (*end || width <= 0 || width > INT_MAX) {
+                snprintf(error, sizeof(error), "invalid width %.24s", value);
+                _reject(j, error);
+            } else {
+                j->issue_width = width;
+            }
+        } else if (n == 2 && !strcmp(word, "policy")) {
+            if (!strcmp(value, "rr")) {
+                j->policy = round_robin;
+            } else if (!strcmp(value, "icount")) {
+                j->policy = icount;
+            } else {
+                snprintf(error, sizeof(error), "unknown policy %.24s", value);
+                _reject(j, error);
+            }
+        } else {
+            snprintf(error, sizeof(error), "unknown directive %s", word);
+            _reject(j, error);
+        }
+    }
+    if (in) {
+        fclose(in);
+    }
+    if (j) {
+        _free_job(j);
+    }
+
+    pthread_mutex_lock(&conn->lock);
+    while (conn->pending) {
+        pthread_cond_wait(&conn->idle, &conn->lock);
+    }
+    pthread_mutex_unlock(&conn->lock);
+
+    pthread_mutex_lock(&srv->lock);
+    struct connection** p = &srv->connections;
+    while (*p != conn) {
+        p = &(*p)->next;
+    }
+    *p = conn->next;
+    pthread_cond_signal(&srv->closed);
+    pthread_mutex_unlock(&srv->lock);
+
+    close(conn->fd);
+    pthread_mutex_destroy(&conn->lock);
+    pthread_cond_destroy(&conn->idle);
+    free(conn);
+    return NULL;
+}
+
+
+static void* _work(void* arg) {
+    struct server* srv = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&srv->lock);
+        while (!srv->first && !srv->stopping) {
+            pthread_cond_wait(&srv->ready, &srv->lock);
+        }
+        if (!srv->first) {
+            pthread_mutex_unlock(&srv->lock);
+            break;
+        }
+        struct job* j = srv->first;
+        srv->first = j->next;
+        if (!srv->first) {
+            srv->last = NULL;
+        }
+        pthread_mutex_unlock(&srv->lock);
+
+        _run_job(srv, j);
+    }
+    return NULL;
+}
+
+
+static void _run_job(struct server* srv, struct job* j) {
+    // the answer is composed in memory and sent in one piece, so that
+    // the blocks of concurrent jobs do not interleave
+    struct connection* conn = j->conn;
+    char* text = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&text, &length);
+
+    if (out) {
+        fprintf(out, "job %d\n", j->id);
+        _simulate_job(srv, j, out);
+        fprintf(out, "end %d\n", j->id);
+        fclose(out);
+    }
+
+    pthread_mutex_lock(&conn->lock);
+    for (size_t sent = 0; text && sent < length; ) {
+        ssize_t n = write(conn->fd, text + sent, length - sent);
+        if (n <= 0) {
+            // client gone, the job is still accounted for
+            break;
+        }
+        sent += n;
+    }
+    conn->pending--;
+    pthread_cond_signal(&conn->idle);
+    pthread_mutex_unlock(&conn->lock);
+
+    free(text);
+    _free_job(j);
+}
+
+
+static int _simulate_job(struct server* srv, struct job* j, FILE* out) {
+    struct machine machine;
+    struct cached_trace* cached[MAX_JOB_THREADS] = {0};
+    struct state s = {0};
+    char** reg_names = NULL;
+    int result = 1;
+
+    if (j->error) {
+        fprintf(out, "error %s\n", j->error);
+        return 1;
+    }
+    if (j->num_traces == 0) {
+        fputs("error no trace\n", out);
+        return 1;
+    }
+
+#ifdef TOMASULO_FIXED
+    if (j->machine_file || j->issue_width) {
+        fputs("error this engine is specialized for a fixed machine\n", out);
+        return 1;
+    }
+    fixed_machine(&machine);
+#else
+    if (j->machine_file) {
+        int line = load_machine(j->machine_file, &machine);
+        if (line) {
+            fprintf(out, "error invalid machine description %s", j->machine_file);
+            if (line > 0) {
+                fprintf(out, ", line %d", line);
+            }
+            fputs("\n", out);
+            return 1;
+        }
+    } else {
+        default_machine(&machine);
+    }
+    if (j->issue_width > 0) {
+        machine.issue_width = j->issue_width;
+    }
+#endif
+
+    s.issue_width = machine.issue_width;
+    s.regfile_size = machine.regfile_size;
+    s.vregfile_size = machine.vregfile_size;
+    s.vector_cycles = (machine.vector_length + machine.lanes - 1) / machine.lanes;
+    s.latency = machine.latency;
+    s.policy = j->policy;
+    s.num_threads = j->num_traces;
+    s.threads = calloc(s.num_threads, sizeof(struct thread));
+    s.stations = create_station_list(10);
+    reg_names = register_names(machine.regfile_size, machine.vregfile_size);
+    if (!s.threads || !s.stations || !reg_names || build_stations(&machine, s.stations)) {
+        fputs("error out of memory\n", out);
+        goto cleanup;
+    }
+
+    // every job simulates on its own copy of the decoded instructions,
+    // the texts stay shared with the cache
+    for (int n = 0; n < s.num_threads; n++) {
+        int error;
+        long line = 0;
+        cached[n] = _cache_get(&srv->cache, j->traces[n], s.regfile_size,
+                               &error, &line);
+        if (!cached[n]) {
+            if (error == -1) {
+                fprintf(out, "error could not load %s\n", j->traces[n]);
+            } else {
+                fprintf(out, "error %s, line %ld : cannot decode instruction (code %d)\n",
+                    j->traces[n], line, error);
+            }
+            goto cleanup;
+        }
+
+        struct ilist* shared = cached[n]->program;
+        struct ilist* program = create_inst_list(shared->occupied ? shared->occupied : 1);
+        if (!program) {
+            fputs("error out of memory\n", out);
+            goto cleanup;
+        }
+        memcpy(program->data, shared->data, shared->occupied * sizeof(struct instruction));
+        program->occupied = shared->occupied;
+        program->complete = true;
+
+        int init = init_thread(&s.threads[n], program, &s);
+        if (init == -2) {
+            fprintf(out, "error %s uses more than %d registers or %d vector registers\n",
+                j->traces[n], s.regfile_size, s.vregfile_size);
+            goto cleanup;
+        } else if (init) {
+            fputs("error out of memory\n", out);
+            goto cleanup;
+        }
+    }
+
+    uint64_t key = 0;
+    if (srv->results) {
+        key = result_key(&s);
+    }
+    if (!srv->results || result_lookup(srv->results, key, &s)) {
+        simulate(&s, reg_names);
+        if (srv->results) {
+            result_store(srv->results, key, &s);
+        }
+    }
+    print_summary(out, &s, j->traces);
+    result = 0;
+
+cleanup:
+    for (int n = 0; n < s.num_threads; n++) {
+        if (s.threads && s.threads[n].program) {
+            _free_program(s.threads[n].program, false);
+            free(s.threads[n].reg_contents);
+        }
+        if (cached[n]) {
+            _cache_release(&srv->cache, cached[n]);
+        }
+    }
+    free(s.threads);
+    if (s.stations) {
+        for (size_t i = 0; i < s.stations->occupied; i++) {
+            free(s.stations->data[i].name);
+        }
+        free(s.stations->data);
+        free(s.stations);
+    }
+    free_register_names(reg_names, machine.regfile_size, machine.vregfile_size);
+    return result;
+}
+
+
+static struct cached_trace* _cache_get(struct trace_cache* c, const char* path,
+                                       int regfile_size, int* error, long* line) {
+    // a trace is decoded again if the file changed since it was cached.
+    // decoding happens outside the lock, other jobs keep using the cache.
+    // The entry found or added moves to the front, past CACHED_TRACES the
+    // entries at the back are evicted
+    struct stat st;
+    struct cached_trace* e;
+
+    *error = -1;
+    if (stat(path, &st)) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    for (struct cached_trace** p = &c->entries; (e = *p) != NULL; p = &e->next) {
+        if (strcmp(e->path, path) || e->regfile_size != regfile_size) {
+            continue;
+        }
+        if (e->size == st.st_size && e->mtime.tv_sec == st.st_mtim.tv_sec &&
+                e->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            *p = e->next;
+            e->next = c->entries;
+            c->entries = e;
+            e->refs++;
+            pthread_mutex_unlock(&c->lock);
+            return e;
+        }
+        // stale, jobs still running on it keep their reference
+        *p = e->next;
+        _cache_drop(e);
+        break;
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    e = calloc(1, sizeof(struct cached_trace));
+    struct ilist* program = create_inst_list(64);
+    if (!e || !program || !(e->path = strdup(path))) {
+        free(e);
+        return NULL;
+    }
+    e->regfile_size = regfile_size;
+    *error = load_trace(path, regfile_size, program, line);
+    if (*error) {
+        _free_program(program, true);
+        free(e->path);
+        free(e);
+        return NULL;
+    }
+    e->program = program;
+    e->mtime = st.st_mtim;
+    e->size = st.st_size;
+    e->refs = 2;
+
+    // another job may have decoded the same file meanwhile
+    pthread_mutex_lock(&c->lock);
+    for (struct cached_trace* other = c->entries; other; other = other->next) {
+        if (!strcmp(other->path, path) && other->regfile_size == regfile_size &&
+                other->size == e->size &&
+                other->mtime.tv_sec == e->mtime.tv_sec &&
+                other->mtime.tv_nsec == e->mtime.tv_nsec) {
+            other->refs++;
+            pthread_mutex_unlock(&c->lock);
+            _free_program(e->program, true);
+            free(e->path);
+            free(e);
+            return other;
+        }
+    }
+    e->next = c->entries;
+    c->entries = e;
+
+    struct cached_trace** last = &c->entries;
+    for (int n = 0; *last && n < CACHED_TRACES; n++) {
+        last = &(*last)->next;
+    }
+    while (*last) {
+        struct cached_trace* evicted = *last;
+        *last = evicted->next;
+        _cache_drop(evicted);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return e;
+}
+
+
+static void _cache_release(struct trace_cache* c, struct cached_trace* e) {
+    pthread_mutex_lock(&c->lock);
+    bool unused = (--e->refs == 0);
+    pthread_mutex_unlock(&c->lock);
+
+    if (unused) {
+        _free_program(e->program, true);
+        free(e->path);
+        free(e);
+    }
+}
+
+
+static void _cache_drop(struct cached_trace* e) {
+    // release the reference of the cache on an entry it no longer lists,
+    // jobs still running on it keep theirs. Called with the lock held
+    if (--e->refs == 0) {
+        _free_program(e->program, true);
+        free(e->path);
+        free(e);
+    }
+}
+
+
+static int _unlink_stale(const char* path, struct sockaddr_un* addr) {
+    // a socket left by a server that crashed refuses connections and is
+    // removed, one that accepts belongs to a running server and is kept.
+    // Anything else than a socket is left for bind to report
+    struct stat st;
+    if (stat(path, &st) || !S_ISSOCK(st.st_mode)) {
+        return 0;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return 0;
+    }
+    int listening = !connect(fd, (struct sockaddr*) addr, sizeof(*addr));
+    close(fd);
+    if (!listening) {
+        unlink(path);
+    }
+    return listening;
+}
+
+
+static void _free_program(struct ilist* program, bool texts) {
+    if (!program) {
+        return;
+    }
+    for (size_t i = 0; texts && i < program->occupied; i++) {
+        free(program->data[i].text);
+    }
+    free(program->data);
+    free(program);
+}
+
+
+static void _free_job(struct job* j) {
+    for (int n = 0; n < j->num_traces; n++) {
+        free(j->traces[n]);
+    }
+    free(j->machine_file);
+    free(j->error);
+    free(j);
+}
+
+
+static void _reject(struct job* j, const char* error) {
+    // the first error of a job is the one reported
+    if (!j->error) {
+        j->error = strdup(error);
+    }
+}
@@ -0,0 +1,123 @@
+/****** server.h ************************************************************
+*   Description
+*       Simulation server accepting jobs over a Unix domain socket for
+*       Tomasulo's algorithm simulator
+*****************************************************************************
+*   This program is free software: you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation, either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*****************************************************************************/
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "instruction.h"
+#include "tomasulo.h"
+
+#define SERVER_SOCKET   "/tmp/tomasulo.sock"
+#define MAX_JOB_THREADS 16
+#define CACHED_TRACES   32      // decoded traces kept between jobs
+
+// Protocol : a client sends jobs as lines of directives, each job ending
+// with "run". Paths must be absolute, the server has its own directory.
+//  trace FILE          a hardware thread running FILE, repeated for SMT
+//  machine FILE        machine description (default machine otherwise)
+//  width N             instructions issued per cycle, N > 0
+//  policy rr|icount    SMT issue policy
+//  run                 submit the job
+// Jobs of a connection run concurrently. Each one is answered, as soon as
+// it completes, by a block of lines between "job N" and "end N", N being
+// its rank on the connection starting at 1. The block holds the summary
+// of a batch run, or a line starting with "error" : a job with more than
+// MAX_JOB_THREADS traces, an invalid width or policy, or an unknown
+// directive is answered that way.
+// The server closes the connection once the client stopped sending and
+// every job is answered. With a result cache, jobs already simulated are
+// answered from it. Once interrupted, the server reads no more jobs but
+// answers every job already submitted before exiting.
+
+// decoded trace, shared by the jobs that use it. A trace modified on disk
+// is decoded again, the old copy is freed once no job uses it anymore.
+// Renamed repeats depend on the register file, it is part of the key.
+// The cache keeps the CACHED_TRACES traces used last, most recent first
+struct cached_trace {
+    char* path;
+    int regfile_size;
+    struct timespec mtime;
+    off_t size;
+    struct ilist* program;
+    int refs;                   // jobs using it, plus one while cached
+    struct cached_trace* next;
+};
+
+struct trace_cache {
+    pthread_mutex_t lock;
+    struct cached_trace* entries;
+};
+
+struct connection {
+    int fd;
+    pthread_mutex_t lock;       // one result block written at a time
+    pthread_cond_t idle;
+    int pending;                // jobs submitted and not yet answered
+    struct connection* next;    // open connections of the server
+};
+
+struct job {
+    struct connection* conn;
+    int id;
+    char* traces[MAX_JOB_THREADS];
+    int num_traces;
+    char* machine_file;
+    int issue_width;            // 0 : as described by the machine
+    enum fetch_policy policy;
+    char* error;                // answered instead of simulating if set
+    struct job* next;
+};
+
+struct server {
+    struct trace_cache cache;
+    const char* results;        // result cache directory, NULL if unused
+    pthread_mutex_t lock;       // job queue and open connections
+    pthread_cond_t ready;
+    struct job* first;
+    struct job* last;
+    struct connection* connections;
+    pthread_cond_t closed;      // a connection was closed
+    bool stopping;              // workers exit once the queue is empty
+};
+
+
+/****** run_server **********************************************************
+*   Serve jobs on a Unix domain socket until interrupted (SIGINT, SIGTERM)
+*       
+*   Parameters : 
+*       const char* path        : socket to create, replaced if it is left
+*                                 over from a server that no longer runs
+*       int workers             : jobs simulated at the same time
+*       const char* results     : result cache directory (see results.h),
+*                                 NULL to always simulate
+*
+*   Return : 0 once interrupted, non-zero if the server cannot start or
+*            another one already listens on path
+*
+*   Side effects : 
+*           the socket is created, then removed on exit. Threads are
+*           started for the workers and for each connection. Every
+*           connection is closed and every worker joined when it returns
+*****************************************************************************/
+int run_server(const char* path, int workers, const char* results);
+
+#endif
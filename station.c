@@ -80,7 +80,7 @@ static struct station _init_station(char* name, enum opclasses type) {
     // this struct initialization method requires C99
     struct station s = (struct station){0};
 
-    s.name = malloc(sizeof(name));
+    s.name = malloc(strlen(name) + 1);
     if (! s.name) {
         return s;
     }
@@ -91,14 +91,27 @@ static struct station _init_station(char* name, enum opclasses type) {
 }
 
 
-void print_station(struct station* st) {
+void print_station(struct slist* list, struct station* st) {
+    char line[80];
+    format_station(line, sizeof(line), list, st);
+    puts(line);
+}
+
+
+int format_station(char* buf, size_t size, struct slist* list,
+                   struct station* st) {
 	char* busy = (st->busy == true) ? "yes" : "no";
 	char* op = (st->busy == true) ? st->op->name : "";
 	char* vj = (st->vj != NULL) ? st->vj : "";
 	char* vk = (st->vk != NULL) ? st->vk : "";
-	char* qj = (st->qj != NULL) ? st->qj : "";
-	char* qk = (st->qk != NULL) ? st->qk : "";
+	const char* qj = station_name(list, st->qj);
+	const char* qk = station_name(list, st->qk);
 
-	printf("|%9s |%7s |%8s |%8s |%8s |%8s |%8s |\n", 
+	return snprintf(buf, size, "|%9s |%7s |%8s |%8s |%8s |%8s |%8s |", 
 			st->name, busy, op, vj, vk, qj, qk);
 }
+
+
+const char* station_name(struct slist* list, int tag) {
+    return tag ? list->data[tag - 1].name : "";
+}
@@ -26,15 +26,20 @@
 #include "instruction.h"
 
 
+// a station is designated by 1 + its index in the list, 0 standing for
+// none : register Qs and qj, qk are compared as integers every cycle
+#define STATION_TAG(list, st)   ((int) ((st) - (list)->data) + 1)
+
 struct station {
     char* name;
     enum opclasses type;
     bool busy;
     struct instruction* op;
+    int thread;
     char* vj;
     char* vk;
-    char* qj;
-    char* qk;
+    int qj;                 // tag of the station producing vj, 0 if none
+    int qk;
 };
 
 struct slist {
@@ -84,6 +89,7 @@ int add_station(struct slist* list, char* name, enum opclasses type);
 * 	"| Name     |  Busy  |    Op   |   Vj    |    Vk   |    Qj   |    Qk   |"
 *       
 *   Parameters : 
+*       struct slist* list      : stations, to name those in Qj and Qk
 *       struct station* st 		: the reservation station to display
 *
 *   Return : none
@@ -91,6 +97,39 @@ int add_station(struct slist* list, char* name, enum opclasses type);
 *   Side effects : 
 *           a line of output is sent to the terminal
 *****************************************************************************/
-void print_station(struct station* st);
+void print_station(struct slist* list, struct station* st);
+
+
+/****** format_station ******************************************************
+*   Same as print_station, but the line is written to a buffer instead of
+*   the terminal (without trailing newline)
+*       
+*   Parameters : 
+*       char* buf               : destination buffer
+*       size_t size             : size of buf
+*       struct slist* list      : stations, to name those in Qj and Qk
+*       struct station* st 		: the reservation station to display
+*
+*   Return : number of characters of the complete line, as snprintf
+*
+*   Side effects : 
+*           buf is modified
+*****************************************************************************/
+int format_station(char* buf, size_t size, struct slist* list,
+                   struct station* st);
+
+
+/****** station_name ********************************************************
+*   Find the name of a station from its tag
+*       
+*   Parameters : 
+*       struct slist* list      : stations
+*       int tag                 : STATION_TAG of the station, 0 for none
+*
+*   Return : name of the station, "" if tag is 0
+*
+*   Side effects : none
+*****************************************************************************/
+const char* station_name(struct slist* list, int tag);
 
 #endif
@@ -23,30 +23,199 @@
 #include "tomasulo.h"
 #include "instruction.h"
 #include "station.h"
-
-
-static struct station* _find_station(struct instruction* inst, struct slist* rs);
-static void _fill_station(struct station* st, struct instruction* inst, 
-                          char* reg_names[], char* reg_contents[]);
+#include "montecarlo.h"
+
+// the specialized engine replaces the machine description found in the
+// state by compile-time constants, letting the compiler unroll the loops
+// over stations and register Qs, fold latencies and station types, and
+// drop latency draws from machines without variations
+#ifdef TOMASULO_FIXED
+static const enum opclasses fixed_types[] = FIXED_STATION_TYPES;
+static const int fixed_latency[] = FIXED_LATENCIES;
+#define NUM_STATIONS(s)         FIXED_NUM_STATIONS
+#define STATION_TYPE(s, i)      fixed_types[i]
+#define ISSUE_WIDTH(s)          FIXED_ISSUE_WIDTH
+#define LATENCY(s, op)          fixed_latency[op]
+#define VECTOR_CYCLES(s)        ((FIXED_VECTOR_LENGTH + FIXED_LANES - 1) / FIXED_LANES)
+#define REGFILE_SIZE(s)         FIXED_REGFILE_SIZE
+#define REG_QS(s)               (FIXED_REGFILE_SIZE + FIXED_VREGFILE_SIZE)
+#define VARIABLE(s)             (FIXED_VARIABLE && (s)->variation)
+#else
+#define NUM_STATIONS(s)         ((s)->stations->occupied)
+#define STATION_TYPE(s, i)      ((s)->stations->data[i].type)
+#define ISSUE_WIDTH(s)          ((s)->issue_width)
+#define LATENCY(s, op)          ((s)->latency[op])
+#define VECTOR_CYCLES(s)        ((s)->vector_cycles)
+#define REGFILE_SIZE(s)         ((s)->regfile_size)
+#define REG_QS(s)               NUM_REGS(s)
+#define VARIABLE(s)             ((s)->variation)
+#endif
+
+// retired instructions kept before compact_thread drops them
+#define COMPACT_MIN     4096
+
+
+static struct station* _find_station(struct instruction* inst, struct state* s);
+static struct thread* _select_thread(struct state* s, struct station** st);
+static void _fill_station(struct station* st, int tag, struct instruction* inst,
+                          char* reg_names[], int reg_contents[],
+                          int regfile_size);
 static bool _ready(struct station* st);
-static void _propagate_result(struct slist* stations, struct station* st);
+static bool _chained(struct state* s, struct station* st);
+static bool _delivering(struct state* s, int q);
+static bool _valid_registers(struct instruction* inst, struct state* s);
+static void _propagate_result(struct state* s, struct station* st);
 static void _clear_station(struct station* st);
 
 
-void retire(struct state* s, char* reg_contents[]) {
-    // for each instruction
+int init_thread(struct thread* t, struct ilist* program, struct state* s) {
+    // this struct initialization method requires C99
+    *t = (struct thread){0};
+    t->program = program;
+
+    t->reg_contents = calloc(NUM_REGS(s), sizeof(int));
+    if (!t->reg_contents) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < program->occupied; i++) {
+        if (!_valid_registers(&program->data[i], s)) {
+            return -2;
+        }
+    }
+    return 0;
+}
+
+
+int append_inst(struct state* s, struct thread* t, struct instruction* inst) {
+    struct instruction* old_data = t->program->data;
+
+    if (!_valid_registers(inst, s)) {
+        return -2;
+    }
+    if (push_inst(t->program, inst)) {
+        return -1;
+    }
+
+    // the list moved, stations holding instructions of this thread must
+    // follow it
+    if (t->program->data != old_data) {
+        int id = t - s->threads;
+        for (size_t i = 0; i < s->stations->occupied; i++) {
+            struct station* st = &s->stations->data[i];
+            if (st->busy && st->thread == id) {
+                st->op = t->program->data + (st->op - old_data);
+            }
+        }
+    }
+    return 0;
+}
+
+
+void compact_thread(struct state* s, struct thread* t) {
+    // only worth it once the retired part is large, the copy is then
+    // paid for by as many retirements
+    struct ilist* program = t->program;
+    size_t dropped = t->head;
+    if (dropped < COMPACT_MIN || dropped * 2 < program->occupied) {
+        return;
+    }
+
+    // copies of a repeated body share its texts, which stay with the loader
+    for (size_t i = 0; i < dropped; i++) {
+        if (!program->data[i].shared_text) {
+            free(program->data[i].text);
+        }
+    }
+    memmove(program->data, program->data + dropped,
+            (program->occupied - dropped) * sizeof(struct instruction));
+    program->occupied -= dropped;
+    program->dropped += dropped;
+    t->head -= dropped;
+    t->next -= dropped;
+
+    int id = t - s->threads;
+    for (size_t i = 0; i < s->stations->occupied; i++) {
+        struct station* st = &s->stations->data[i];
+        if (st->busy && st->thread == id) {
+            st->op -= dropped;
+        }
+    }
+}
+
+
+void simulate(struct state* s, char* reg_names[]) {
+    for (s->cycle = 1; !s->complete; s->cycle++) {
+        retire(s);
+        issue(s, reg_names);
+        execute(s);
+        writeback(s);
+    }
+}
+
+
+void print_summary(FILE* out, struct state* s, char* traces[]) {
+    // the loop exits one increment past the cycle where the last
+    // instruction retired
+    long cycles = s->cycle - 1;
+    long total = 0;
+
+    fputs("\n", out);
+    fprintf(out, "Cycles : %ld\n", cycles);
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
+        long active = t->last_retire ? t->last_retire : 1;
+        fprintf(out, "Thread %d (%s) : %ld instructions in %ld cycles, IPC %.3f\n",
+            n, traces[n], t->retired, active, (double) t->retired / active);
+        total += t->retired;
+    }
+    if (s->num_threads > 1) {
+        fprintf(out, "Aggregate : %ld instructions in %ld cycles, IPC %.3f\n",
+            total, cycles, cycles ? (double) total / cycles : 0.0);
+    }
+}
+
+static bool _valid_registers(struct instruction* inst, struct state* s) {
+    if (inst->opclass == vector) {
+        return inst->rd < s->vregfile_size && inst->rs1 < s->vregfile_size
+            && inst->rs2 < s->vregfile_size;
+    }
+    return (inst->rd >> 1) < s->regfile_size && (inst->rs1 >> 1) < s->regfile_size
+        && (inst->rs2 >> 1) < s->regfile_size;
+}
+
+
+void retire(struct state* s) {
+    // for each thread
+    // for each issued instruction not yet retired
     // if writeback != 0 and != current cycle
     // set retired to current cycle
-    // clear destination register Qi (data is now in registers)
 
-    for(size_t i = 0; i < s->program->occupied; i++) {
-        struct instruction* inst = &s->program->data[i];
+    bool complete = true;
+
+    for (int n = 0; n < s->num_threads; n++) {
+        struct thread* t = &s->threads[n];
 
-        if (inst->writeback && !inst->retired && inst->writeback != s->cycle) {
-            inst->retired = s->cycle;
-            reg_contents[inst->rd >> 1] = "";
+        for (size_t i = t->head; i < t->next; i++) {
+            struct instruction* inst = &t->program->data[i];
+
+            if (inst->writeback && !inst->retired && inst->writeback != s->cycle) {
+                inst->retired = s->cycle;
+                t->retired++;
+                t->last_retire = s->cycle;
+            }
+        }
+
+        // retirement is out of order, only move past a contiguous prefix
+        while (t->head < t->next && t->program->data[t->head].retired) {
+            t->head++;
+        }
+
+        if (t->head < t->program->occupied || !t->program->complete) {
+            complete = false;
         }
     }
+    s->complete = complete;
 }
 
 
@@ -57,14 +226,16 @@ void writeback(struct state* s) {
         // set writeback to current cycle
         // to simulate the CDB, we must next update all stations that
         // are waiting on this one by moving the blocker from Qx to Vx
+        // and the registers it was to write
         // finally we clear the station and make it available again
 
-    for (size_t i = 0; i < s->stations->occupied; i++) {
+    for (size_t i = 0; i < NUM_STATIONS(s); i++) {
         struct station* st = &s->stations->data[i];
         if (st->busy) {
             if (!st->op->remaining) {
                 st->op->writeback = s->cycle;
-                _propagate_result(s->stations, st);
+                s->threads[st->thread].in_flight--;
+                _propagate_result(s, st);
                 _clear_station(st);
             }
         }
@@ -72,25 +243,31 @@ void writeback(struct state* s) {
 }
 
 
-static void _propagate_result(struct slist* stations, struct station* cdb) {
+static void _propagate_result(struct state* s, struct station* cdb) {
     // for each station that waits on results from cdb
     // move source from Qx to Vx
+    // register Qis that still name cdb are cleared as well, a register
+    // renamed again by a later instruction keeps waiting on that one
+
+    int tag = STATION_TAG(s->stations, cdb);
+    int* reg_contents = s->threads[cdb->thread].reg_contents;
+    for (int r = 0; r < REG_QS(s); r++) {
+        if (reg_contents[r] == tag) {
+            reg_contents[r] = 0;
+        }
+    }
 
-    for (size_t i = 0; i < stations->occupied; i++) {
-        struct station* st = &stations->data[i];
+    for (size_t i = 0; i < NUM_STATIONS(s); i++) {
+        struct station* st = &s->stations->data[i];
 
-        if (st->qj) {
-            if (!strcmp(st->qj, cdb->name)) {
-                st->vj = cdb->name;
-                st->qj = NULL;
-            }
+        if (st->qj == tag) {
+            st->vj = cdb->name;
+            st->qj = 0;
         }
 
-        if (st->qk) {
-            if (!strcmp(st->qk, cdb->name)) {
-                st->vk = cdb->name;
-                st->qk = NULL;
-            }
+        if (st->qk == tag) {
+            st->vk = cdb->name;
+            st->qk = 0;
         }
     }
 }
@@ -113,12 +290,15 @@ void execute(struct state* s) {
     //              start execution
     //          else 
     //              decrement remaining cycles of instruction
+    // vector operands may be chained instead of available
 
-    for(size_t i = 0; i < s->stations->occupied; i++) {
+    for(size_t i = 0; i < NUM_STATIONS(s); i++) {
         struct station* st = &s->stations->data[i];
 
         if (st->busy) {
-            if ((st->op->opclass == loadstore) || _ready(st)) {
+            // a station only holds instructions of its own type
+            if ((STATION_TYPE(s, i) == loadstore) || _ready(st) ||
+                    (STATION_TYPE(s, i) == vector && _chained(s, st))) {
                 if (st->op->issue != s->cycle) {
                     if (!st->op->execute) {
                         st->op->execute = s->cycle;
@@ -140,67 +320,144 @@ static bool _ready(struct station* st) {
 }
 
 
-void issue(struct state* s, char* reg_names[], char* reg_contents[]) {
-    struct instruction* inst;
+static bool _chained(struct state* s, struct station* st) {
+    // a vector instruction starts as soon as the units producing its
+    // operands deliver their first elements. It then consumes elements at
+    // the rate they are produced and keeps going until its own last ones,
+    // whether the operands were written back meanwhile or not
+    if (st->op->execute || !has_sources(st->op)) {
+        return true;
+    }
+    return _delivering(s, st->qj) && _delivering(s, st->qk);
+}
+
+
+static bool _delivering(struct state* s, int q) {
+    // the first elements leave a vector unit once its latency has elapsed,
+    // they can be read from the next cycle, as a written back result
+    if (!q) {
+        return true;
+    }
+    struct station* st = &s->stations->data[q - 1];
+    return st->busy && st->op->execute &&
+           s->cycle > st->op->execute + st->op->latency;
+}
+
+
+void issue(struct state* s, char* reg_names[]) {
+    struct thread* t;
     struct station* st;
-    size_t i = 0;
-
-    // retrieve first unissued instruction
-    while(i <= s->program->occupied) {
-        inst = NULL;
-        st = NULL;
-
-        if (s->program->data[i].issue == 0) {
-            inst = &s->program->data[i];
-            
-            // try to issue instruction
-            st = _find_station(inst, s->stations);
-            if (!st) {
-                // no station available, try next instruction
-                continue;   
-            }
 
-            // station available, send instruction
-            _fill_station(st, inst, reg_names, reg_contents);
-            inst->issue = s->cycle;
+    for (int slot = 0; slot < ISSUE_WIDTH(s); slot++) {
+        t = _select_thread(s, &st);
+        if (!t) {
+            // no instruction can be issued this cycle
             return;
         }
-        i++;
+
+        // station available, send next instruction of the thread
+        struct instruction* inst = &t->program->data[t->next];
+        int tag = STATION_TAG(s->stations, st);
+        _fill_station(st, tag, inst, reg_names, t->reg_contents, REGFILE_SIZE(s));
+        st->thread = t - s->threads;
+        inst->station = tag - 1;
+        inst->issue = s->cycle;
+        inst->latency = LATENCY(s, inst->op);
+        if (VARIABLE(s)) {
+            inst->latency = draw_latency(&s->variation[inst->op], inst->latency,
+                                         &s->rng);
+        }
+        inst->remaining = inst->latency;
+        if (inst->opclass == vector) {
+            // one more cycle for each group of lanes after the first
+            inst->remaining += VECTOR_CYCLES(s) - 1;
+        }
+        t->next++;
+        t->in_flight++;
+    }
+}
+
+
+static struct thread* _select_thread(struct state* s, struct station** st) {
+    // threads issue in program order : a thread whose next instruction
+    // finds no free station is stalled for this slot.
+    // candidates are considered starting from rr_next so that ties are
+    // broken fairly under both policies
+
+    struct thread* best = NULL;
+    struct station* best_st = NULL;
+    int best_id = 0;
+
+    for (int n = 0; n < s->num_threads; n++) {
+        int id = (s->rr_next + n) % s->num_threads;
+        struct thread* t = &s->threads[id];
+
+        if (t->next >= t->program->occupied) {
+            continue;
+        }
+        struct station* free_st = _find_station(&t->program->data[t->next], s);
+        if (!free_st) {
+            continue;
+        }
+
+        if (!best || (s->policy == icount && t->in_flight < best->in_flight)) {
+            best = t;
+            best_st = free_st;
+            best_id = id;
+        }
+        if (s->policy == round_robin) {
+            break;
+        }
     }
-    // no instruction can be issued this cycle
-    return;
+
+    if (best) {
+        s->rr_next = (best_id + 1) % s->num_threads;
+    }
+    *st = best_st;
+    return best;
 }
 
 
-static void _fill_station(struct station* st, struct instruction* inst, 
-                            char* reg_names[], char* reg_contents[]) {
+static void _fill_station(struct station* st, int tag, struct instruction* inst,
+                          char* reg_names[], int reg_contents[],
+                          int regfile_size) {
     st->busy = true;
     st->op = inst;
-    reg_contents[inst->rd >>1] = st->name;
 
-    if (inst->opclass != loadstore) {
+    if (has_sources(inst)) {
+        int rs1 = reg_index(inst, inst->rs1, regfile_size);
+        int rs2 = reg_index(inst, inst->rs2, regfile_size);
+
         // if source register 1 is ready (i.e. not waiting)
-        if (! strcmp(reg_contents[inst->rs1 >>1], "")) {
-            st->vj = reg_names[inst->rs1 >>1];
+        if (!reg_contents[rs1]) {
+            st->vj = reg_names[rs1];
         } else {
             // indicate stall source
-            st->qj = reg_contents[inst->rs1 >>1];     
+            st->qj = reg_contents[rs1];     
         }
 
         // if source register 2 is ready (i.e. not waiting)
-        if (! strcmp(reg_contents[inst->rs2 >>1], "")) {
-            st->vk = reg_names[inst->rs2 >>1];
+        if (!reg_contents[rs2]) {
+            st->vk = reg_names[rs2];
         } else {
             // indicate stall source
-            st->qk = reg_contents[inst->rs2 >>1];     
+            st->qk = reg_contents[rs2];     
         }
     }
+
+    // sources are read before renaming the destination, an instruction
+    // such as "addd F0, F0, F2" must not wait on itself
+    if (has_destination(inst)) {
+        reg_contents[reg_index(inst, inst->rd, regfile_size)] = tag;
+    }
 }
 
 
-static struct station* _find_station(struct instruction* inst, struct slist* rs) {
-    for(size_t i = 0; i < rs->occupied; i++) {
-        if(rs->data[i].type == inst->opclass) {
+static struct station* _find_station(struct instruction* inst, struct state* s) {
+    struct slist* rs = s->stations;
+
+    for(size_t i = 0; i < NUM_STATIONS(s); i++) {
+        if(STATION_TYPE(s, i) == inst->opclass) {
             if(!rs->data[i].busy) {
                 return &rs->data[i];
             }
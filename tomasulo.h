@@ -21,32 +21,133 @@
 #ifndef TOMASULO_H
 #define TOMASULO_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "instruction.h"
 
-struct state {
+#ifdef TOMASULO_FIXED
+// the machine is fixed at build time, see machine_fixed.h.in
+#include "machine_fixed.h"
+#endif
+
+// order in which hardware threads compete for the issue slots
+//  round_robin : rotate priority between threads every issued instruction
+//  icount      : favor the thread with the fewest instructions in stations
+enum fetch_policy {round_robin, icount};
+
+// see machine.h
+struct distribution;
+
+// register Qs of a thread, the scalar registers then the vector ones
+#define NUM_REGS(s)     ((s)->regfile_size + (s)->vregfile_size)
+
+struct thread {
     struct ilist* program;
+    int* reg_contents;      // register Qs, private to each thread : tag of
+                            // the station writing each register, 0 if none
+    size_t head;            // oldest instruction not yet retired
+    size_t next;            // next instruction to issue (in order)
+    int in_flight;          // issued but not yet written back
+    long retired;
+    long last_retire;       // cycle of the most recent retirement
+};
+
+struct state {
+    struct thread* threads;
+    int num_threads;
+    enum fetch_policy policy;
+    int rr_next;            // first thread considered for the next slot
     struct slist* stations;
-    int cycle;
+    long cycle;
     int issue_width;
     int regfile_size;
+    int vregfile_size;      // vector register Qs follow the scalar ones
+    int vector_cycles;      // cycles to go through every element of a vector
+    const int* latency;     // execution cycles, indexed by enum opcode
+    const struct distribution* variation;   // latencies drawn at issue,
+                                            // indexed by enum opcode
+    uint64_t rng;           // random sequence of the draws
     bool complete;
 };
 
+
+/****** init_thread *********************************************************
+*   Prepare a hardware thread to run a program
+*       
+*   Parameters : 
+*       struct thread* t        : thread to initialize
+*       struct ilist* program   : instructions executed by this thread
+*       struct state* s         : simulation context, only its register
+*                                 file sizes are used
+*
+*   Return : 0 if succesfull, 
+*            -1 if memory allocation fails
+*            -2 if the program uses registers beyond s->regfile_size or
+*               vector registers beyond s->vregfile_size
+*
+*   Side effects : 
+*           memory for the scalar and vector register Qs is allocated, all
+*           of them initially empty.
+*****************************************************************************/
+int init_thread(struct thread* t, struct ilist* program, struct state* s);
+
+
+/****** append_inst *********************************************************
+*   Add an instruction to the program of a thread while it runs, for
+*   programs loaded concurrently with the simulation. The thread is only
+*   complete once its program->complete is set.
+*       
+*   Parameters : 
+*       struct state* s         : current simulation context
+*       struct thread* t        : thread receiving the instruction
+*       struct instruction* inst: decoded instruction, copied
+*
+*   Return : 0 if succesfull, 
+*            -1 if memory allocation fails
+*            -2 if the instruction uses registers beyond s->regfile_size
+*               or vector registers beyond s->vregfile_size
+*
+*   Side effects : 
+*           the program list may move, stations are updated accordingly
+*****************************************************************************/
+int append_inst(struct state* s, struct thread* t, struct instruction* inst);
+
+
+/****** compact_thread ******************************************************
+*   Drop the retired instructions at the front of the program of a thread
+*   once they fill most of it, so that a long trace loaded concurrently
+*   does not stay in memory. Instruction indices of the thread are then
+*   relative to program->dropped. The texts they own are freed : nothing
+*   may keep pointers to them (see --analyze in main.c).
+*       
+*   Parameters : 
+*       struct state* s         : current simulation context
+*       struct thread* t        : thread whose program is compacted
+*
+*   Return : none
+*
+*   Side effects : 
+*           the program list moves, stations are updated accordingly
+*****************************************************************************/
+void compact_thread(struct state* s, struct thread* t);
+
 /****** issue ***************************************************************
 *   Dispatch instructions to reservation stations
+*   Up to issue_width instructions are sent each cycle, in program order
+*   within a thread. Threads share the slots according to s->policy.
 *       
 *   Parameters : 
 *       struct state* s 		: current simulation context
 *       char *reg_names[]   	: array of string, the names of register Qs
-*       char *reg_contents[]   	: array of string, the contents of register Qs
 *
 *   Return : none
 *
 *   Side effects : 
 *           instructions, reservation stations and register Qs are modified
 *****************************************************************************/
-void issue(struct state* s, char* reg_names[], char* reg_contents[]);
+void issue(struct state* s, char* reg_names[]);
 
 
 /****** execute *************************************************************
@@ -76,25 +177,57 @@ void execute(struct state* s);
 *   Return : none
 *
 *   Side effects : 
-*           instructions and reservation stations are modified
+*           instructions, reservation stations and register Qs are modified
 *****************************************************************************/
 void writeback(struct state* s);
 
 
 /****** retire ***********************************************************
 *   For all instructions,
-*   wait for writeback to complete then clear register Q
+*   wait for writeback to complete then mark the instruction retired
 * 		
 *       
 *   Parameters : 
 *       struct state* s 		: current simulation context
-*       char *reg_contents[]   	: array of string, the contents of register Qs
 *
 *   Return : none
 *
 *   Side effects : 
-*           instructions and register Qs are modified
+*           instructions of every thread are modified,
+*           s->complete is set once all threads have retired their program
+*****************************************************************************/
+void retire(struct state* s);
+
+
+/****** simulate ************************************************************
+*   Run the simulation to completion, for programs that are entirely loaded
+*       
+*   Parameters : 
+*       struct state* s 		: simulation context, before the first cycle
+*       char *reg_names[]   	: array of string, the names of register Qs
+*
+*   Return : none
+*
+*   Side effects : 
+*           instructions, reservation stations and register Qs are modified,
+*           s->cycle is one past the last cycle simulated
+*****************************************************************************/
+void simulate(struct state* s, char* reg_names[]);
+
+
+/****** print_summary *******************************************************
+*   Display the cycle count and the throughput of each thread
+*       
+*   Parameters : 
+*       FILE* out               : destination of the summary
+*       struct state* s 		: simulation context, once complete
+*       char *traces[]          : name of the trace of each thread
+*
+*   Return : none
+*
+*   Side effects : 
+*           the summary is written to out
 *****************************************************************************/
-void retire(struct state* s, char* reg_contents[]);
+void print_summary(FILE* out, struct state* s, char* traces[]);
 
 #endif